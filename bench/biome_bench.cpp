@@ -0,0 +1,175 @@
+// Microbenchmark for the biome column fill.
+//
+// Fills columns of random biomes and heights through the compile-time biome
+// table and through the previous path (an unordered_map lookup per column, a
+// switch per block and a std::function tree callback), checks that both
+// produce the same blocks and reports the time per column.
+//
+//   ./biome_bench [columns] [rounds]
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "biome.hpp"
+
+// The biome as it was before the table, with a type-erased tree builder
+struct LegacyBiome {
+  BiomeKind kind;
+  int maxHeight;
+  std::function<void(u32&, int)> treeGen;
+};
+
+// The per-block switch the table replaced
+inline BlockType legacy_block_type_for_height(LegacyBiome const& bk, int height,
+                                              int maxHeight) {
+  int top = bk.maxHeight - BLOCKS_OF_AIR_ABOVE;
+  switch (bk.kind) {
+    case BiomeKind::Desert:
+      if (height == maxHeight) return BlockType::Sand;
+      if (height > (top - 6)) return BlockType::Sand;
+      if (height > (top - 20)) return BlockType::Dirt;
+      return BlockType::Stone;
+    case BiomeKind::Grassland:
+    case BiomeKind::Forest:
+      if (height == maxHeight) return BlockType::TopGrass;
+      if (height > (top - 20)) return BlockType::Dirt;
+      return BlockType::Stone;
+    case BiomeKind::Tundra:
+      if (height == maxHeight) return BlockType::Snow;
+      if (height > (top - 20)) return BlockType::Snow;
+      return BlockType::Stone;
+    case BiomeKind::Taiga:
+      if (height == maxHeight) return BlockType::TopSnow;
+      if (height > (top - 20)) return BlockType::Dirt;
+      return BlockType::Stone;
+    case BiomeKind::Mountains:
+      if (height > (top - 6)) return BlockType::Snow;
+      return BlockType::Stone;
+    case BiomeKind::Ocean:
+    case BiomeKind::Coast:
+      return BlockType::Sand;
+    case BiomeKind::Jungle:
+      if (height == maxHeight) return BlockType::JungleTopGrass;
+      if (height > (top - 20)) return BlockType::Dirt;
+      return BlockType::Stone;
+    default:
+      return BlockType::Unknown;
+  }
+}
+
+inline void legacy_fill_column(
+    std::unordered_map<BiomeKind, LegacyBiome> const& biomes, Block* output,
+    BiomeKind kind, int columnHeight, u32& trees) {
+  auto& lb = biomes.at(kind);
+  columnHeight = std::min(columnHeight, CHUNK_HEIGHT);
+  for (int height = columnHeight - 1; height >= 0; --height) {
+    output[height].type =
+        legacy_block_type_for_height(lb, height, columnHeight - 1);
+  }
+  while (columnHeight < WATER_LEVEL) {
+    output[columnHeight].type = BlockType::Water;
+    columnHeight++;
+  }
+  for (int i = columnHeight; i < CHUNK_HEIGHT; ++i) {
+    output[i].type = BlockType::Air;
+  }
+  lb.treeGen(trees, columnHeight);
+}
+
+template <TreeKind T>
+inline void count_tree(u32& trees, int columnHeight) {
+  if constexpr (T != TreeKind::None) trees += columnHeight & 1;
+}
+
+inline void table_fill_column(BiomeTable const& biomes, Block* output,
+                              BiomeKind kind, int columnHeight, u32& trees) {
+  with_biome(kind, [&](auto tag) {
+    constexpr BiomeKind K = decltype(tag)::value;
+    fill_biome_column<K>(biomes[kind], output, columnHeight);
+    count_tree<BIOME_TREES[K]>(
+        trees, std::max(std::min(columnHeight, CHUNK_HEIGHT), WATER_LEVEL));
+  });
+}
+
+struct Column {
+  BiomeKind kind;
+  int height;
+};
+
+template <typename Fill>
+double run_fill(vector<Column> const& columns, u32 rounds, vector<Block>& out,
+                Fill fill) {
+  auto start = std::chrono::high_resolution_clock::now();
+  for (u32 r = 0; r < rounds; ++r) {
+    for (size_t i = 0; i < columns.size(); ++i) {
+      fill(&out[i * CHUNK_HEIGHT], columns[i].kind, columns[i].height);
+    }
+  }
+  auto now = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::nano>(now - start).count();
+}
+
+int main(int argc, char** argv) {
+  u32 ncolumns = argc > 1 ? std::stoul(argv[1]) : 4096;
+  u32 rounds = argc > 2 ? std::stoul(argv[2]) : 64;
+
+  BiomeTable table;
+  init_biomes(table, 2873947234821);
+  std::unordered_map<BiomeKind, LegacyBiome> legacy;
+  for (auto& biome : table) {
+    legacy.insert({biome.kind, LegacyBiome{biome.kind, biome.maxHeight,
+                                           [](u32&, int) {}}});
+    if (BIOME_TREES[biome.kind] != TreeKind::None) {
+      legacy.at(biome.kind).treeGen = count_tree<TreeKind::Oak>;
+    }
+  }
+
+  // the same random biomes and heights for both paths
+  vector<Column> columns(ncolumns);
+  u64 state = 88172645463325252ull;
+  for (auto& column : columns) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    column.kind = (BiomeKind)((state >> 33) % BiomeKind::Count);
+    column.height = (int)((state >> 17) % (CHUNK_HEIGHT + 8));
+  }
+
+  fmt::print("biome columns: {} columns of {} blocks, {} rounds\n", ncolumns,
+             CHUNK_HEIGHT, rounds);
+
+  vector<Block> legacy_out(ncolumns * CHUNK_HEIGHT);
+  vector<Block> table_out(ncolumns * CHUNK_HEIGHT);
+  u32 legacy_trees = 0;
+  u32 table_trees = 0;
+  double legacy_ns = run_fill(columns, rounds, legacy_out,
+                              [&](Block* out, BiomeKind kind, int height) {
+                                legacy_fill_column(legacy, out, kind, height,
+                                                   legacy_trees);
+                              });
+  double table_ns = run_fill(columns, rounds, table_out,
+                             [&](Block* out, BiomeKind kind, int height) {
+                               table_fill_column(table, out, kind, height,
+                                                 table_trees);
+                             });
+
+  double n = (double)ncolumns * rounds;
+  fmt::print("{:>8}: {:8.2f} ns/column\n", "map", legacy_ns / n);
+  fmt::print("{:>8}: {:8.2f} ns/column  x{:.2f}\n", "table", table_ns / n,
+             legacy_ns / table_ns);
+
+  size_t mismatches = 0;
+  for (size_t i = 0; i < legacy_out.size(); ++i) {
+    if (legacy_out[i].type != table_out[i].type) mismatches++;
+  }
+  if (mismatches != 0 || legacy_trees != table_trees) {
+    fmt::print("FAIL: {} blocks differ, trees {} vs {}\n", mismatches,
+               legacy_trees, table_trees);
+    return 1;
+  }
+  fmt::print("ok: identical blocks\n");
+  return 0;
+}
@@ -0,0 +1,631 @@
+// Headless world generation benchmark.
+//
+// Runs the worldgen stages without a window: the climate noise tiles,
+// gen_chunk with both height blendings, the meshings done by load_chunk_at and
+// the loading of a whole region on the chunk generation pool, generated and
+// read back from its region files. The sides of the region's chunk meshes are
+// then meshed again on the pool against the neighbours that arrived later.
+// Reports the throughput and latency percentiles of each stage, then the cost
+// of logging player edits and replaying them, and of looking chunks up at the
+// largest render distance.
+//
+// Before that, the blocks of a fixed set of chunks are hashed and compared
+// against golden values for GOLDEN_SEED, so a faster worldgen is known to
+// generate the same world. When the world is changed on purpose, the new
+// values are printed in the form of the tables below.
+//
+//   ./minecraft_bench [chunks] [region radius]
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "world.hpp"
+
+constexpr Seed GOLDEN_SEED = 2873947234821;
+
+struct GoldenChunk {
+  i32 x;
+  i32 y;
+  // blocks hash for HeightBlending::Exact and HeightBlending::Lattice
+  u64 exact;
+  u64 lattice;
+};
+
+// gen_chunk of single chunks, without the structures of their neighbours
+constexpr GoldenChunk GOLDEN_CHUNKS[] = {
+    {0, 0, 0x0b85e84adb3e091a, 0xe942fdf9fe855cb6},
+    {-16, 0, 0x71c641231d098f86, 0x15ad2441e3eb146a},
+    {4096, -1216, 0xba89650e2b33f5f9, 0x8f1a78a70b5123a1},
+    {-20000, 7648, 0xcf393c718b00e316, 0x09085659ef451548},
+    {123456, -65536, 0xd28c3013c1b9b097, 0xded70e0ad90e016d},
+    {-800, 3200, 0x74454cc95542ccd3, 0x0aa2858c70d403e5},
+    {1600, 1600, 0x3695a11beb477835, 0xb158da01fcc016cf},
+    {-50000, -50000, 0x363896b7546e179d, 0x1c8fec8ca0a9658d},
+};
+
+// All the chunks of the region around the origin, as loaded by the game,
+// structures spilled between them included
+constexpr u32 GOLDEN_REGION_RADIUS = 2;
+constexpr u64 GOLDEN_REGION_HASH = 0x34097ea20c13c0fc;
+
+constexpr u64 FNV_OFFSET = 14695981039346656037ull;
+constexpr u64 FNV_PRIME = 1099511628211ull;
+
+// FNV-1a of the block types, in (x, y, height) order
+u64 chunk_blocks_hash(Chunk& chunk, u64 hash = FNV_OFFSET) {
+  for (int x = 0; x < CHUNK_WIDTH; ++x) {
+    for (int y = 0; y < CHUNK_LENGTH; ++y) {
+      for (int z = 0; z < CHUNK_HEIGHT; ++z) {
+        hash ^= (u64)chunk_blocks_get(chunk.blocks, x, y, z).type;
+        hash *= FNV_PRIME;
+      }
+    }
+  }
+  return hash;
+}
+
+using BenchClock = std::chrono::high_resolution_clock;
+
+template <typename F>
+inline double time_ms(F&& f) {
+  auto start = BenchClock::now();
+  f();
+  return std::chrono::duration<double, std::milli>(BenchClock::now() - start)
+      .count();
+}
+
+inline double percentile(vector<double> const& sorted, double p) {
+  if (sorted.empty()) return 0.0;
+  return sorted[(size_t)(p * (double)(sorted.size() - 1))];
+}
+
+// `ms` holds the time of each chunk
+void print_stage(const char* name, vector<double> ms) {
+  std::sort(ms.begin(), ms.end());
+  double total = 0.0;
+  for (auto t : ms) total += t;
+  double chunks_per_s = (double)ms.size() / total * 1000.0;
+  fmt::print(
+      "{:>12}: {:9.1f} chunks/s {:11.0f} columns/s  p50 {:.3f} p95 {:.3f} "
+      "p99 {:.3f} max {:.3f} ms\n",
+      name, chunks_per_s, chunks_per_s * CHUNK_WIDTH * CHUNK_LENGTH,
+      percentile(ms, 0.5), percentile(ms, 0.95), percentile(ms, 0.99),
+      ms.back());
+}
+
+// Spread over the world, so the chunks do not share noise lattice cells
+inline ChunkId bench_chunk_pos(u32 i) {
+  i32 x = (i32)((i * 37) % 101) - 50;
+  i32 y = (i32)((i * 53) % 89) - 44 + (i32)(i / 101) * 89;
+  return chunk_id_from_coords(x * CHUNK_WIDTH, y * CHUNK_LENGTH);
+}
+
+inline void reset_chunk(Chunk& chunk, i32 x, i32 y) {
+  chunk.x = x;
+  chunk.y = y;
+  chunk.is_being_generated = true;
+  chunk.is_stale = false;
+}
+
+struct RegionResult {
+  double ms = 0.0;
+  u64 chunks = 0;
+  // jobs run, chunks regenerated for the structures of their neighbours
+  // included
+  u64 jobs = 0;
+  u32 passes = 0;
+  u64 hash = FNV_OFFSET;
+  // pending structure blocks once the region is loaded
+  u64 structure_mods = 0;
+  size_t structure_bytes = 0;
+  ChunkBlocksStats blocks;
+  // chunks read from their region file, and the time to save the region
+  u64 chunks_loaded = 0;
+  double save_ms = 0.0;
+  u64 saved_bytes = 0;
+  // vertices of the meshes once their sides are meshed against the
+  // neighbours the way the game does it, and of the meshes without
+  // the neighbours
+  u64 vertices = 0;
+  u64 vertices_alone = 0;
+  // chunks whose sides were meshed again on the pool, the time it took and
+  // the time the render thread spent queueing them
+  u64 sides_remeshed = 0;
+  double sides_ms = 0.0;
+  double sides_queue_ms = 0.0;
+  // meshes that differ from the mesh of the chunk built again from scratch
+  u64 side_mismatches = 0;
+};
+
+// Copies the patch of the chunk into its mesh, the way the render thread does
+// it with the uploaded buffer
+void apply_mesh_patch(Chunk& chunk, ChunkMesh& mesh) {
+  auto patch = std::move(chunk.mesh_patch);
+  auto& sections = chunk.mesh_sections;
+  auto patched = chunk_mesh_patched_sections(sections, *patch);
+  ChunkMesh out;
+  out.reserve(patched[CHUNK_MESH_PARTS]);
+  for (u32 part = 0; part < CHUNK_MESH_PARTS; ++part) {
+    if (patch->parts[part]) {
+      auto& added = patch->meshes[part];
+      out.insert(out.end(), added.begin(), added.end());
+      continue;
+    }
+    out.insert(out.end(), mesh.begin() + sections[part],
+               mesh.begin() + sections[part + 1]);
+  }
+  mesh = std::move(out);
+  sections = patched;
+  chunk.mesh_size = mesh.size();
+}
+
+bool same_mesh(ChunkMesh const& a, ChunkMesh const& b) {
+  return a.size() == b.size() &&
+         std::memcmp(a.data(), b.data(), a.size() * sizeof(VertexData)) == 0;
+}
+
+// Loads the chunks around the origin the way the game does: loading passes on
+// the world's generation pool, repeated while structure blocks spilled into
+// chunks that were already generated. The chunks are loaded from and saved
+// to the region files in `save_dir` when it is given.
+RegionResult load_region(Seed seed, u32 radius, string const& save_dir = "") {
+  RegionResult result;
+  auto world = make_unique<World>();
+  init_world(*world, seed);
+  world_open_saves(*world, save_dir);
+  chunk_grid_resize(world->grid, radius * 2);
+  WorldPos center{0, 0, 0};
+  vec3 view_dir{1.0f, 0.0f, 0.0f};
+
+  result.ms = time_ms([&] {
+    bool stale = true;
+    while (stale) {
+      load_chunks_around_player(*world, center, radius, view_dir);
+      chunk_pool_wait(world->gen_pool);
+      result.passes++;
+      stale = false;
+      for (auto* chunk : world->grid.cells) {
+        if (!chunk->is_stale) continue;
+        // the next pass meshes it again, the render thread is not there to
+        // take the old mesh
+        delete chunk->mesh;
+        chunk->mesh = nullptr;
+        stale = true;
+      }
+    }
+  });
+  result.chunks = world->grid.cells.size();
+  result.jobs = world->gen_pool.jobs_done;
+
+  // the workers meshed the sides against the neighbours that were there, the
+  // render thread queues them again as the others arrive
+  for (auto* chunk : world->grid.cells) {
+    chunk->is_dirty = false;
+    chunk->mesh_size = chunk->mesh->size();
+  }
+  result.sides_ms = time_ms([&] {
+    result.sides_queue_ms = time_ms([&] {
+      world_queue_side_remeshes(*world, center, view_dir);
+    });
+    chunk_pool_wait(world->gen_pool);
+  });
+  for (auto* chunk : world->grid.cells) {
+    if (!chunk->mesh_patch) continue;
+    apply_mesh_patch(*chunk, *chunk->mesh);
+    result.sides_remeshed++;
+  }
+  chunk_pool_stop(world->gen_pool);
+  result.structure_mods = world->structures.mods;
+  result.structure_bytes = world->structures.bytes;
+  result.chunks_loaded = world->chunks_loaded;
+  result.save_ms = time_ms([&] {
+    world_save_chunks(*world);
+    region_store_close(world->saves);
+  });
+  result.saved_bytes = world->saves.bytes_written;
+
+  for (auto* chunk : world->grid.cells) {
+    ChunkMesh mesh;
+    gen_chunk_mesh(*chunk, world->meshing, world->quads, mesh);
+    if (!same_mesh(mesh, *chunk->mesh)) result.side_mismatches++;
+    result.vertices += mesh.size();
+    mesh.clear();
+    auto& blocks = dense_blocks_scratch();
+    chunk_blocks_unpack(chunk->blocks, blocks);
+    gen_chunk_mesh(*chunk, blocks, ChunkHalo{}, world->meshing, world->quads,
+                   mesh);
+    result.vertices_alone += mesh.size();
+    delete chunk->mesh;
+    chunk->mesh = nullptr;
+  }
+
+  auto chunks = world->grid.cells;
+  chunk_grid_resize(world->grid, 0);
+  std::sort(chunks.begin(), chunks.end(), [](Chunk* a, Chunk* b) {
+    return chunk_id_from_coords(a->x, a->y) < chunk_id_from_coords(b->x, b->y);
+  });
+  for (auto* chunk : chunks) {
+    result.hash = chunk_blocks_hash(*chunk, result.hash);
+    chunk_blocks_add_stats(result.blocks, chunk->blocks);
+    chunk_slab_release(world->chunk_slabs, chunk);
+  }
+  chunk_map_clear(world->loaded_chunks);
+  return result;
+}
+
+// Render distance of the chunk lookup stage, the largest the game allows
+constexpr i32 LOOKUP_RADIUS = 32;
+constexpr u32 LOOKUPS = 1 << 22;
+
+// The hash of the loaded chunks before ChunkMap, for comparison
+struct xor_hash_pair {
+  size_t operator()(ChunkId const& p) const {
+    return std::hash<i32>{}(p.first) ^ std::hash<i32>{}(p.second);
+  }
+};
+
+inline i32 floor_to_chunk(i32 v, i32 size) {
+  return v - ((v % size) + size) % size;
+}
+
+// Looks up random blocks and chunks of a loaded square of LOOKUP_RADIUS,
+// through get_block_at_global_pos and is_chunk_loaded, and through the
+// locked unordered_map they used before
+void bench_chunk_lookup() {
+  auto world = make_unique<World>();
+  std::unordered_map<ChunkId, Chunk*, xor_hash_pair> old_map;
+  std::mutex old_mutex;
+  i32 first_x = -LOOKUP_RADIUS * CHUNK_WIDTH;
+  i32 first_y = -LOOKUP_RADIUS * CHUNK_LENGTH;
+  vector<Chunk*> chunks;
+  for (i32 row = 0; row < 2 * LOOKUP_RADIUS; ++row) {
+    for (i32 col = 0; col < 2 * LOOKUP_RADIUS; ++col) {
+      auto* chunk = chunk_slab_acquire(world->chunk_slabs);
+      chunk->x = first_x + col * CHUNK_WIDTH;
+      chunk->y = first_y + row * CHUNK_LENGTH;
+      chunk->is_being_generated = false;
+      auto id = chunk_id_from_coords(chunk->x, chunk->y);
+      chunk_map_insert(world->loaded_chunks, id, chunk);
+      old_map.emplace(id, chunk);
+      chunks.push_back(chunk);
+    }
+  }
+
+  // a sixteenth of the lookups miss, around the edges of the square
+  ChunkRng rng(GOLDEN_SEED, 0, 0);
+  i32 width = 2 * LOOKUP_RADIUS * CHUNK_WIDTH;
+  i32 length = 2 * LOOKUP_RADIUS * CHUNK_LENGTH;
+  i32 margin = width / 32;
+  vector<WorldPos> positions(LOOKUPS);
+  for (auto& pos : positions) {
+    u64 r = rng.next();
+    pos.x = first_x - margin + (i32)(r % (u32)(width + 2 * margin));
+    pos.y = first_y - margin + (i32)((r >> 24) % (u32)(length + 2 * margin));
+    pos.z = (i32)((r >> 48) % CHUNK_HEIGHT);
+  }
+
+  u64 found = 0;
+  auto report = [&](const char* name, double ms) {
+    fmt::print("{:>12}: {:9.1f} ns/lookup, {} found\n", name,
+               ms * 1e6 / LOOKUPS, found);
+    found = 0;
+  };
+  double ms = time_ms([&] {
+    for (auto& pos : positions) {
+      found += get_block_at_global_pos(*world, pos).has_value();
+    }
+  });
+  report("block lookup", ms);
+  ms = time_ms([&] {
+    for (auto& pos : positions) {
+      found += is_chunk_loaded(*world, floor_to_chunk(pos.x, CHUNK_WIDTH),
+                               floor_to_chunk(pos.y, CHUNK_LENGTH)) != nullptr;
+    }
+  });
+  report("chunk lookup", ms);
+  ms = time_ms([&] {
+    for (auto& pos : positions) {
+      std::lock_guard<std::mutex> guard(old_mutex);
+      auto id = chunk_id_from_coords(floor_to_chunk(pos.x, CHUNK_WIDTH),
+                                     floor_to_chunk(pos.y, CHUNK_LENGTH));
+      found += old_map.find(id) != old_map.end();
+    }
+  });
+  report("xor map", ms);
+
+  for (auto* chunk : chunks) chunk_slab_release(world->chunk_slabs, chunk);
+}
+
+// Edits of the edit log stage, made in EDIT_CHUNKS chunks at random positions
+// of their lowest EDIT_LAYERS layers, so many positions are edited again
+constexpr u32 EDITS = 1 << 18;
+constexpr i32 EDIT_CHUNKS = 8;
+constexpr u32 EDIT_LAYERS = 4;
+
+// The edits of the journal, in order of chunk and position
+vector<std::tuple<ChunkId, u32, BlockType>> edit_journal_contents(
+    EditJournal const& journal) {
+  vector<std::tuple<ChunkId, u32, BlockType>> contents;
+  edit_journal_for_each(journal, [&](ChunkId chunk, BlockEdit const& edit) {
+    contents.push_back({chunk, chunk_edit_key(edit), edit.block});
+  });
+  std::sort(contents.begin(), contents.end());
+  return contents;
+}
+
+// Logs edits as the render thread does, then replays the log into another
+// journal. False when the replayed journal differs.
+bool bench_edit_log() {
+  auto dir = fs::temp_directory_path() / "minecraft_bench_edits";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  auto path = (dir / "edits.log").string();
+
+  EditJournal journal;
+  EditLog log;
+  edit_log_open(log, path, journal);
+  ChunkRng rng(GOLDEN_SEED, 1, 1);
+  double ms = time_ms([&] {
+    for (u32 i = 0; i < EDITS; ++i) {
+      u64 r = rng.next();
+      ChunkId chunk{(i32)(r % EDIT_CHUNKS) * CHUNK_WIDTH, 0};
+      BlockEdit edit{
+          .x = (u8)((r >> 8) % CHUNK_WIDTH),
+          .y = (u8)((r >> 16) % CHUNK_LENGTH),
+          .z = (u8)((r >> 24) % EDIT_LAYERS),
+          .block = (r >> 32) % 2 ? BlockType::Stone : BlockType::Air,
+      };
+      edit_journal_record(journal, chunk, edit);
+      edit_log_append(log, chunk, edit);
+    }
+  });
+  double flush_ms = time_ms([&] { edit_log_flush(log); });
+  u64 syncs = log.batches;
+  u64 compactions = log.compactions;
+  edit_log_close(log);
+  u64 log_bytes = fs::file_size(path);
+
+  EditJournal replayed;
+  double replay_ms = time_ms([&] { edit_log_open(log, path, replayed); });
+  u64 records = log.records_replayed;
+  edit_log_close(log);
+  fs::remove_all(dir);
+
+  fmt::print(
+      "{:>12}: {:9.1f} ns/edit, {} edits in {} syncs, flushed in {:.1f} ms, "
+      "{} compactions\n",
+      "edit log", ms * 1e6 / EDITS, EDITS, syncs, flush_ms, compactions);
+  fmt::print(
+      "{:>12}  replayed {} records, {:.1f} KB, in {:.1f} ms for {} edited "
+      "positions\n",
+      "", records, log_bytes / 1024.0, replay_ms,
+      edit_journal_positions(replayed));
+  if (edit_journal_contents(replayed) != edit_journal_contents(journal)) {
+    fmt::print("edit log: MISMATCH, the replayed edits differ\n");
+    return false;
+  }
+  return true;
+}
+
+// Whether the indexed quads of the mesh draw the same triangles as the mesh
+// meshed without indices
+bool same_triangles(ChunkMesh const& indexed, ChunkMesh const& triangles) {
+  size_t quads = indexed.size() / 4;
+  if (quads * 4 != indexed.size() || quads * 6 != triangles.size()) {
+    return false;
+  }
+  for (size_t quad = 0; quad < quads; ++quad) {
+    for (u32 i = 0; i < 6; ++i) {
+      auto a = indexed[quad * 4 + CHUNK_QUAD_INDICES[i]];
+      auto b = triangles[quad * 6 + i];
+      if (a.corner_face_tile != b.corner_face_tile ||
+          a.texture_shade != b.texture_shade) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool check_golden() {
+  auto world = make_unique<World>();
+  init_world(*world, GOLDEN_SEED);
+  auto chunk = make_unique<Chunk>();
+  bool ok = true;
+  vector<GoldenChunk> actual;
+  for (auto& golden : GOLDEN_CHUNKS) {
+    GoldenChunk got{golden.x, golden.y, 0, 0};
+    for (auto blending : {HeightBlending::Exact, HeightBlending::Lattice}) {
+      world->height_blending = blending;
+      reset_chunk(*chunk, golden.x, golden.y);
+      ChunkSpill spill;
+      gen_chunk(*world, *chunk, spill);
+      auto& hash = blending == HeightBlending::Exact ? got.exact : got.lattice;
+      hash = chunk_blocks_hash(*chunk);
+    }
+    ok = ok && got.exact == golden.exact && got.lattice == golden.lattice;
+    actual.push_back(got);
+  }
+  auto region = load_region(GOLDEN_SEED, GOLDEN_REGION_RADIUS);
+  ok = ok && region.hash == GOLDEN_REGION_HASH;
+
+  if (ok) {
+    fmt::print("golden: {} chunks and the {}x{} region match\n",
+               actual.size(), GOLDEN_REGION_RADIUS * 2,
+               GOLDEN_REGION_RADIUS * 2);
+    return true;
+  }
+  fmt::print("golden: MISMATCH, the generated world changed. Got:\n");
+  fmt::print("constexpr GoldenChunk GOLDEN_CHUNKS[] = {{\n");
+  for (auto& got : actual) {
+    fmt::print("    {{{}, {}, {:#018x}, {:#018x}}},\n", got.x, got.y, got.exact,
+               got.lattice);
+  }
+  fmt::print("}};\n");
+  fmt::print("constexpr u64 GOLDEN_REGION_HASH = {:#018x};\n", region.hash);
+  return false;
+}
+
+int main(int argc, char** argv) {
+  u32 nchunks = argc > 1 ? std::stoul(argv[1]) : 256;
+  u32 radius = argc > 2 ? std::stoul(argv[2]) : 6;
+
+  fmt::print(
+      "minecraft_bench: seed {}, {} chunks, {}x{} region, {} workers, noise "
+      "kernel {}\n",
+      GOLDEN_SEED, nchunks, radius * 2, radius * 2, chunk_pool_default_size(),
+      noise_kernel_name(noise_detect_kernel()));
+
+  bool ok = check_golden();
+
+  auto world = make_unique<World>();
+  init_world(*world, GOLDEN_SEED);
+  auto chunk = make_unique<Chunk>();
+
+  vector<double> ms(nchunks);
+  for (u32 i = 0; i < nchunks; ++i) {
+    auto pos = bench_chunk_pos(i);
+    reset_chunk(*chunk, pos.first, pos.second);
+    ms[i] = time_ms([&] { gen_chunk_climate(*world, *chunk); });
+  }
+  print_stage("noise tiles", ms);
+
+  for (auto blending : {HeightBlending::Exact, HeightBlending::Lattice}) {
+    world->height_blending = blending;
+    for (u32 i = 0; i < nchunks; ++i) {
+      auto pos = bench_chunk_pos(i);
+      reset_chunk(*chunk, pos.first, pos.second);
+      ChunkSpill spill;
+      ms[i] = time_ms([&] { gen_chunk(*world, *chunk, spill); });
+    }
+    print_stage(blending == HeightBlending::Exact ? "gen exact" : "gen lattice",
+                ms);
+  }
+
+  // the meshings, which have to cover the same block faces, and the binary
+  // one has to build the same meshes as the cubes. They are timed with
+  // indexed quads, which have to draw the same triangles as the quads meshed
+  // without indices.
+  world->height_blending = HeightBlending::Exact;
+  u64 cube_faces = 0;
+  for (auto meshing :
+       {ChunkMeshing::Cubes, ChunkMeshing::Greedy, ChunkMeshing::Binary}) {
+    u64 vertices = 0;
+    u64 triangle_vertices = 0;
+    u64 faces = 0;
+    u32 mismatches = 0;
+    u32 binary_mismatches = 0;
+    for (u32 i = 0; i < nchunks; ++i) {
+      auto pos = bench_chunk_pos(i);
+      reset_chunk(*chunk, pos.first, pos.second);
+      ChunkSpill spill;
+      gen_chunk(*world, *chunk, spill);
+      ChunkMesh mesh;
+      ms[i] = time_ms([&] {
+        gen_chunk_mesh(*chunk, meshing, ChunkQuads::Indexed, mesh);
+      });
+      ChunkMesh triangles;
+      gen_chunk_mesh(*chunk, meshing, ChunkQuads::Triangles, triangles);
+      vertices += mesh.size();
+      triangle_vertices += triangles.size();
+      faces += chunk_mesh_block_faces(mesh, ChunkQuads::Indexed);
+      if (!same_triangles(mesh, triangles)) mismatches++;
+      if (meshing == ChunkMeshing::Binary) {
+        ChunkMesh cubes;
+        gen_chunk_mesh(*chunk, ChunkMeshing::Cubes, ChunkQuads::Indexed,
+                       cubes);
+        if (!same_mesh(mesh, cubes)) binary_mismatches++;
+      }
+    }
+    const char* name = meshing == ChunkMeshing::Greedy   ? "mesh greedy"
+                       : meshing == ChunkMeshing::Binary ? "mesh binary"
+                                                         : "mesh cubes";
+    print_stage(name, ms);
+    fmt::print(
+        "{:>12}  {:.0f} vertices/chunk, {:.1f} KB, {:.1f} per block face; "
+        "{:.1f} KB as triangles\n",
+        "", (double)vertices / (double)nchunks,
+        vertices * sizeof(VertexData) / 1024.0 / nchunks,
+        (double)vertices / (double)faces,
+        triangle_vertices * sizeof(VertexData) / 1024.0 / nchunks);
+    if (mismatches != 0) {
+      fmt::print("{}: MISMATCH, {} chunks draw other triangles when indexed\n",
+                 name, mismatches);
+      ok = false;
+    }
+    if (binary_mismatches != 0) {
+      fmt::print("{}: MISMATCH, {} chunks meshed unlike the cubes\n", name,
+                 binary_mismatches);
+      ok = false;
+    }
+    if (meshing == ChunkMeshing::Cubes) cube_faces = faces;
+    if (faces != cube_faces) {
+      fmt::print("{}: MISMATCH, {} block faces instead of {}\n", name, faces,
+                 cube_faces);
+      ok = false;
+    }
+  }
+
+  auto region = load_region(GOLDEN_SEED, radius);
+  double chunks_per_s = (double)region.chunks / region.ms * 1000.0;
+  fmt::print(
+      "{:>12}: {:9.1f} chunks/s {:11.0f} columns/s  {:.1f} ms, {} jobs for {} "
+      "chunks in {} passes\n",
+      fmt::format("region {}x{}", radius * 2, radius * 2), chunks_per_s,
+      chunks_per_s * CHUNK_WIDTH * CHUNK_LENGTH, region.ms, region.jobs,
+      region.chunks, region.passes);
+  fmt::print("{:>12}  {} pending structure blocks, {:.1f} KB\n", "",
+             region.structure_mods, region.structure_bytes / 1024.0);
+  auto& blocks = region.blocks;
+  fmt::print(
+      "{:>12}  blocks {:.1f} KB/chunk, {:.1f} KB dense; sections {} air, {} "
+      "uniform, {} palette\n",
+      "", blocks.bytes / 1024.0 / region.chunks,
+      blocks.dense_bytes / 1024.0 / region.chunks, blocks.air_sections,
+      blocks.uniform_sections, blocks.palette_sections);
+  fmt::print(
+      "{:>12}  {:.0f} vertices/chunk, {:.1f}% fewer than without the "
+      "neighbours; sides of {} chunks meshed again in {:.2f} ms, queued in "
+      "{:.3f} ms\n",
+      "", (double)region.vertices / region.chunks,
+      100.0 - 100.0 * region.vertices / std::max<u64>(region.vertices_alone, 1),
+      region.sides_remeshed, region.sides_ms, region.sides_queue_ms);
+  if (region.side_mismatches != 0) {
+    fmt::print("region: MISMATCH, {} meshes differ once their sides are "
+               "meshed again\n",
+               region.side_mismatches);
+    ok = false;
+  }
+
+  // the region again, saved and then loaded back from its region files
+  auto save_dir = fs::temp_directory_path() / "minecraft_bench_saves";
+  fs::remove_all(save_dir);
+  auto saved = load_region(GOLDEN_SEED, radius, save_dir);
+  auto restored = load_region(GOLDEN_SEED, radius, save_dir);
+  fs::remove_all(save_dir);
+  chunks_per_s = (double)restored.chunks / restored.ms * 1000.0;
+  fmt::print(
+      "{:>12}: {:9.1f} chunks/s {:11.0f} columns/s  {:.1f} ms, {} of {} "
+      "chunks from disk, {} jobs\n",
+      "saved region", chunks_per_s, chunks_per_s * CHUNK_WIDTH * CHUNK_LENGTH,
+      restored.ms, restored.chunks_loaded, restored.chunks, restored.jobs);
+  fmt::print("{:>12}  saved in {:.1f} ms, {:.1f} KB/chunk on disk\n", "",
+             saved.save_ms, saved.saved_bytes / 1024.0 / saved.chunks);
+  bool saves_match = saved.hash == region.hash && restored.hash == region.hash;
+  if (!saves_match) {
+    fmt::print("saved region: MISMATCH, the chunks read back differ\n");
+  }
+  ok = ok && saves_match;
+
+  ok = bench_edit_log() && ok;
+  bench_chunk_lookup();
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+// Microbenchmark for OpenSimplexNoiseWParam::noise_tile.
+//
+// Fills chunk sized tiles with every noise kernel, reports the throughput of
+// each one and checks that the vector kernels stay within
+// NOISE_TILE_TOLERANCE of the scalar path.
+//
+//   ./noise_bench [tiles] [octaves]
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "noise.hpp"
+
+constexpr u32 TILE_WIDTH = 16;
+constexpr u32 TILE_LENGTH = 16;
+constexpr u32 TILE_POINTS = TILE_WIDTH * TILE_LENGTH;
+
+struct KernelResult {
+  double ms = 0.0;
+  float max_error = 0.0f;
+};
+
+KernelResult run_kernel(OpenSimplexNoiseWParam const& noise, NoiseKernel kernel,
+                        u32 tiles, u32 octaves, vector<float> const& reference,
+                        vector<float>& out) {
+  KernelResult result;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (u32 t = 0; t < tiles; ++t) {
+    // walk a diagonal so the tiles do not share lattice cells
+    i32 x0 = (i32)t * (i32)TILE_WIDTH - 4096;
+    i32 y0 = (i32)t * (i32)TILE_LENGTH * 3 - 4096;
+    noise.noise_tile(octaves, x0, y0, TILE_WIDTH, TILE_LENGTH,
+                     &out[t * TILE_POINTS], 1, kernel);
+  }
+  auto now = std::chrono::high_resolution_clock::now();
+  result.ms = std::chrono::duration<double, std::milli>(now - start).count();
+  if (!reference.empty()) {
+    for (size_t i = 0; i < out.size(); ++i) {
+      result.max_error =
+          std::max(result.max_error, std::fabs(out[i] - reference[i]));
+    }
+  }
+  return result;
+}
+
+int main(int argc, char** argv) {
+  u32 tiles = argc > 1 ? std::stoul(argv[1]) : 4096;
+  u32 octaves = argc > 2 ? std::stoul(argv[2]) : 4;
+
+  // same parameters as the mountains biome height noise
+  OpenSimplexNoiseWParam noise{0.001f, 64.0f, 2.0f, 0.5f, 2873947234821};
+
+  fmt::print("noise_tile: {} tiles of {}x{}, {} octaves, best kernel: {}\n",
+             tiles, TILE_WIDTH, TILE_LENGTH, octaves,
+             noise_kernel_name(noise_detect_kernel()));
+
+  vector<float> reference(tiles * TILE_POINTS);
+  vector<float> out(tiles * TILE_POINTS);
+  auto scalar =
+      run_kernel(noise, NoiseKernel::Scalar, tiles, octaves, {}, reference);
+  double points = (double)tiles * TILE_POINTS;
+  fmt::print("{:>8}: {:9.2f} ms {:8.2f} Mpoints/s\n",
+             noise_kernel_name(NoiseKernel::Scalar), scalar.ms,
+             points / scalar.ms / 1000.0);
+
+  bool ok = true;
+  for (auto kernel : {NoiseKernel::AVX2}) {
+    if ((int)kernel > (int)noise_detect_kernel()) {
+      fmt::print("{:>8}: not supported by this CPU\n",
+                 noise_kernel_name(kernel));
+      continue;
+    }
+    auto res = run_kernel(noise, kernel, tiles, octaves, reference, out);
+    bool within = res.max_error <= NOISE_TILE_TOLERANCE;
+    ok = ok && within;
+    fmt::print("{:>8}: {:9.2f} ms {:8.2f} Mpoints/s  x{:.2f}  max error {:g}{}\n",
+               noise_kernel_name(kernel), res.ms, points / res.ms / 1000.0,
+               scalar.ms / res.ms, res.max_error,
+               within ? "" : " (above tolerance!)");
+  }
+
+  return ok ? 0 : 1;
+}
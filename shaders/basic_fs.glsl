@@ -1,7 +1,8 @@
 #version 330 core
 
 // Interpolated values from the vertex shaders
-in vec2 UV;
+flat in vec2 tile_origin;
+in vec2 tile_pos;
 in vec3 fragment_normal;
 in float fragment_ao;
 in float fragment_light;
@@ -17,10 +18,17 @@ uniform sampler2D myTextureSampler;
 in vec3 fragment_light_pos;
 uniform vec3 sky_color;
 
+// side of a block texture in the atlas, TEXTURE_TILE_WIDTH / TEXTURE_WIDTH
+const float TILE_SIZE = 16.0 / 256.0;
+// keeps the lookups off the neighbouring textures
+const float TILE_INSET = 1.0 / 2048.0;
+
 void main(){
     vec3 lightColor = vec3(1.0, 1.0, 1.0);
 
-    // Take color from the atlas texture
+    // Take color from the atlas texture, repeated over the blocks of the face
+    vec2 UV = tile_origin + clamp(fract(tile_pos) * TILE_SIZE, TILE_INSET,
+                                  TILE_SIZE - TILE_INSET);
     vec3 color = vec3(texture2D(myTextureSampler, UV));
     if (color == vec3(1.0, 0.0, 1.0)) {
       // skip the missing textures
@@ -1,21 +1,33 @@
 #version 330 core
 
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec2 texUV;
-layout(location = 3) in float ao;
-layout(location = 4) in float light;
+// a VertexData: the block corner, face and position in the face, then the
+// atlas tile, ao and light
+layout(location = 0) in uvec2 vertex;
 
 uniform mat4 view;
 uniform mat4 projection;
+// of the chunk being drawn, the vertex corners are relative to it
+uniform vec3 chunk_origin;
 
 uniform vec3 light_pos;
 
 uniform float fog_gradient;
 uniform float fog_density;
 
+// side of a block texture in the atlas, TEXTURE_TILE_WIDTH / TEXTURE_WIDTH
+const float TILE_SIZE = 16.0 / 256.0;
+const uint ATLAS_TILES_PER_ROW = 16u;
+
+// in order left, right, top, bottom, front, back, as in world.cpp
+const vec3 FACE_NORMALS[6] = vec3[6](
+    vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0),
+    vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0));
+
 // Output data ; will be interpolated for each fragment.
-out vec2 UV;
+// the corner of the block texture in the atlas, and the position in the face
+// in blocks, the texture being repeated once per block
+flat out vec2 tile_origin;
+out vec2 tile_pos;
 out float fragment_light;
 out float fragment_ao;
 out vec3 fragment_normal;
@@ -25,10 +37,22 @@ out float visibility;
 
 void main()
 {
-    fragment_light = light;
-    fragment_ao = ao;
-    fragment_normal = normal;
+    uint bits = vertex.x;
+    vec3 corner = vec3(bits & 31u, (bits >> 5) & 511u, (bits >> 14) & 31u);
+    uint face = (bits >> 19) & 7u;
+    tile_pos = vec2((bits >> 22) & 31u, bits >> 27);
+
+    uint texture_tile = vertex.y & 255u;
+    tile_origin = vec2(texture_tile % ATLAS_TILES_PER_ROW,
+                       ATLAS_TILES_PER_ROW - 1u -
+                           texture_tile / ATLAS_TILES_PER_ROW) *
+                  TILE_SIZE;
+    fragment_ao = float((vertex.y >> 8) & 255u) / 255.0;
+    fragment_light = float((vertex.y >> 16) & 255u) / 255.0;
+    fragment_normal = FACE_NORMALS[face];
 
+    // the corners are half a block from the block centers
+    vec3 position = chunk_origin + corner - 0.5;
     vec4 world_position = vec4(position, 1.0);
     vec4 position_relative_to_cam = view * world_position;
     gl_Position = projection * position_relative_to_cam;
@@ -37,6 +61,5 @@ void main()
     visibility = exp(-pow((distance * fog_density), fog_gradient));
 
     FragPos = position;
-    UV = texUV;
     fragment_light_pos = light_pos;
 }
@@ -0,0 +1,86 @@
+#include "biome.hpp"
+
+void init_biomes(BiomeTable &biomes, Seed seed) {
+  int bseed = seed;
+
+  // Desert
+  biomes[BiomeKind::Desert] = Biome{
+      .kind = BiomeKind::Desert,
+      .maxHeight = (int)(CHUNK_HEIGHT * 0.55),
+      .noise = OpenSimplexNoiseWParam{0.00002f, 16.0f, 2.0f, 0.5f, bseed},
+      .treeFrequency = 0.0f,
+      .name = "Desert",
+  };
+
+  // Forest
+  biomes[BiomeKind::Forest] = Biome{
+      .kind = BiomeKind::Forest,
+      .maxHeight = (int)(CHUNK_HEIGHT * 0.65),
+      .noise = OpenSimplexNoiseWParam{0.004f, 32.0f, 2.0f, 0.5f, bseed},
+      .treeFrequency = 0.03f,
+      .name = "Forest",
+  };
+
+  // Jungle
+  biomes[BiomeKind::Jungle] = Biome{
+      .kind = BiomeKind::Jungle,
+      .maxHeight = (int)(CHUNK_HEIGHT * 0.66),
+      .noise = OpenSimplexNoiseWParam{0.01f, 32.0f, 2.0f, 0.5f, bseed},
+      .treeFrequency = 0.05f,
+      .name = "Jungle",
+  };
+
+  // Taiga
+  biomes[BiomeKind::Taiga] = Biome{
+      .kind = BiomeKind::Taiga,
+      .maxHeight = (int)(CHUNK_HEIGHT * 0.56),
+      .noise = OpenSimplexNoiseWParam{0.004f, 32.0f, 2.0f, 0.5f, bseed},
+      .treeFrequency = 0.02f,
+      .name = "Taiga",
+  };
+
+  // Grassland
+  biomes[BiomeKind::Grassland] = Biome{
+      .kind = BiomeKind::Grassland,
+      .maxHeight = (int)(CHUNK_HEIGHT * 0.55),
+      .noise = OpenSimplexNoiseWParam{0.00001f, 32.0f, 2.0f, 0.5f, bseed},
+      .treeFrequency = 0.0072f,
+      .name = "Grassland",
+  };
+
+  // Tundra
+  biomes[BiomeKind::Tundra] = Biome{
+      .kind = BiomeKind::Tundra,
+      .maxHeight = (int)(CHUNK_HEIGHT * 0.54),
+      .noise = OpenSimplexNoiseWParam{0.002f, 32.0f, 2.0f, 0.5f, bseed},
+      .treeFrequency = 0.005f,
+      .name = "Tundra",
+  };
+
+  // Oceans
+  biomes[BiomeKind::Ocean] = Biome{
+      .kind = BiomeKind::Ocean,
+      .maxHeight = (int)(WATER_LEVEL * 0.8),
+      .noise = OpenSimplexNoiseWParam{0.001f, 1.0f, 2.0f, 0.5f, bseed},
+      .treeFrequency = 0.0f,
+      .name = "Ocean",
+  };
+
+  // Coast
+  biomes[BiomeKind::Coast] = Biome{
+      .kind = BiomeKind::Coast,
+      .maxHeight = WATER_LEVEL + 3,
+      .noise = OpenSimplexNoiseWParam{0.001f, 1.0f, 2.0f, 0.5f, bseed},
+      .treeFrequency = 0.0001f,
+      .name = "Coast",
+  };
+
+  // Mountains
+  biomes[BiomeKind::Mountains] = Biome{
+      .kind = BiomeKind::Mountains,
+      .maxHeight = CHUNK_HEIGHT,
+      .noise = OpenSimplexNoiseWParam{0.001f, 64.0f, 2.0f, 0.5f, bseed},
+      .treeFrequency = 0.004f,
+      .name = "Mountains",
+  };
+}
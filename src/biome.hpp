@@ -0,0 +1,145 @@
+#ifndef BIOME_HPP
+#define BIOME_HPP
+
+#include <algorithm>
+#include <array>
+#include <type_traits>
+
+#include "block.hpp"
+#include "noise.hpp"
+
+enum BiomeKind {
+  Grassland,
+  Mountains,
+  Desert,
+  Ocean,
+  Tundra,
+  Taiga,
+  Forest,
+  Coast,
+  Jungle,
+  Count,
+};
+
+enum class TreeKind {
+  None,
+  Oak,
+  Jungle,
+  Pine,
+};
+
+// Blocks a biome fills its columns with, by layer. The layers are relative to
+// the biome top, BLOCKS_OF_AIR_ABOVE below its max height.
+struct SurfaceRule {
+  // the top block of the column, or Unknown to keep the block of its layer
+  BlockType top;
+  // above the biome top - 6
+  BlockType upper;
+  // above the biome top - 20
+  BlockType middle;
+  BlockType lower;
+};
+
+// Indexed by BiomeKind
+constexpr SurfaceRule SURFACE_RULES[BiomeKind::Count] = {
+    // Grassland
+    {BlockType::TopGrass, BlockType::Dirt, BlockType::Dirt, BlockType::Stone},
+    // Mountains
+    {BlockType::Unknown, BlockType::Snow, BlockType::Stone, BlockType::Stone},
+    // Desert
+    {BlockType::Sand, BlockType::Sand, BlockType::Dirt, BlockType::Stone},
+    // Ocean
+    {BlockType::Sand, BlockType::Sand, BlockType::Sand, BlockType::Sand},
+    // Tundra
+    {BlockType::Snow, BlockType::Snow, BlockType::Snow, BlockType::Stone},
+    // Taiga
+    {BlockType::TopSnow, BlockType::Dirt, BlockType::Dirt, BlockType::Stone},
+    // Forest
+    {BlockType::TopGrass, BlockType::Dirt, BlockType::Dirt, BlockType::Stone},
+    // Coast
+    {BlockType::Sand, BlockType::Sand, BlockType::Sand, BlockType::Sand},
+    // Jungle
+    {BlockType::JungleTopGrass, BlockType::Dirt, BlockType::Dirt,
+     BlockType::Stone},
+};
+
+// Indexed by BiomeKind
+constexpr TreeKind BIOME_TREES[BiomeKind::Count] = {
+    TreeKind::Oak,     // Grassland
+    TreeKind::Oak,     // Mountains
+    TreeKind::None,    // Desert
+    TreeKind::None,    // Ocean
+    TreeKind::Pine,    // Tundra
+    TreeKind::Pine,    // Taiga
+    TreeKind::Oak,     // Forest
+    TreeKind::Oak,     // Coast
+    TreeKind::Jungle,  // Jungle
+};
+
+struct Biome {
+  BiomeKind kind;
+  int maxHeight;
+  OpenSimplexNoiseWParam noise;
+  float treeFrequency;
+  const char* name;
+};
+
+// Indexed by BiomeKind
+using BiomeTable = std::array<Biome, BiomeKind::Count>;
+
+void init_biomes(BiomeTable& biomes, Seed seed);
+
+template <BiomeKind K>
+using BiomeTag = std::integral_constant<BiomeKind, K>;
+
+// Calls `f(BiomeTag<kind>{})`, which lets `f` use the kind as a template
+// argument. This is the only runtime dispatch on the biome kind in the column
+// loops: a jump table, no hashing and no type-erased calls.
+template <typename F>
+inline decltype(auto) with_biome(BiomeKind kind, F&& f) {
+  switch (kind) {
+    case BiomeKind::Mountains:
+      return f(BiomeTag<BiomeKind::Mountains>{});
+    case BiomeKind::Desert:
+      return f(BiomeTag<BiomeKind::Desert>{});
+    case BiomeKind::Ocean:
+      return f(BiomeTag<BiomeKind::Ocean>{});
+    case BiomeKind::Tundra:
+      return f(BiomeTag<BiomeKind::Tundra>{});
+    case BiomeKind::Taiga:
+      return f(BiomeTag<BiomeKind::Taiga>{});
+    case BiomeKind::Forest:
+      return f(BiomeTag<BiomeKind::Forest>{});
+    case BiomeKind::Coast:
+      return f(BiomeTag<BiomeKind::Coast>{});
+    case BiomeKind::Jungle:
+      return f(BiomeTag<BiomeKind::Jungle>{});
+    default:
+      return f(BiomeTag<BiomeKind::Grassland>{});
+  }
+}
+
+// Fills a column of CHUNK_HEIGHT blocks: the biome layers up to
+// `columnHeight`, water up to WATER_LEVEL and air above
+template <BiomeKind K>
+inline void fill_biome_column(Biome const& biome, Block* output,
+                              int columnHeight) {
+  constexpr SurfaceRule rule = SURFACE_RULES[K];
+  columnHeight = std::clamp(columnHeight, 0, CHUNK_HEIGHT);
+  int top = biome.maxHeight - BLOCKS_OF_AIR_ABOVE;
+  // each layer starts at the first height above its threshold
+  int middle_start = std::clamp(top - 20 + 1, 0, columnHeight);
+  int upper_start = std::clamp(top - 6 + 1, 0, columnHeight);
+  int height = 0;
+  for (; height < middle_start; ++height) output[height].type = rule.lower;
+  for (; height < upper_start; ++height) output[height].type = rule.middle;
+  for (; height < columnHeight; ++height) output[height].type = rule.upper;
+  if constexpr (rule.top != BlockType::Unknown) {
+    if (columnHeight > 0) output[columnHeight - 1].type = rule.top;
+  }
+  for (; height < WATER_LEVEL; ++height) output[height].type = BlockType::Water;
+  // fill the rest with air
+  for (; height < CHUNK_HEIGHT; ++height) output[height].type = BlockType::Air;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef BYTE_STREAM_HPP
+#define BYTE_STREAM_HPP
+
+#include <cstring>
+#include <type_traits>
+
+#include "common.hpp"
+
+// Values written to and read from byte buffers as they are in memory, for the
+// files the game writes and reads back on the same machine
+
+template <typename T>
+inline void byte_write(vector<u8>& out, T const& value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  auto* bytes = reinterpret_cast<u8 const*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+inline void byte_write_bytes(vector<u8>& out, void const* data, size_t size) {
+  auto* bytes = static_cast<u8 const*>(data);
+  out.insert(out.end(), bytes, bytes + size);
+}
+
+// Reads from [at, end). Reading past the end sets `failed` and reads zeroes,
+// so a truncated buffer is checked for once at the end.
+struct ByteReader {
+  u8 const* at;
+  u8 const* end;
+  bool failed = false;
+};
+
+inline bool byte_read_bytes(ByteReader& in, void* data, size_t size) {
+  // `data` of an empty vector may be null
+  if (size == 0) return !in.failed;
+  if (in.failed || (size_t)(in.end - in.at) < size) {
+    in.failed = true;
+    std::memset(data, 0, size);
+    return false;
+  }
+  std::memcpy(data, in.at, size);
+  in.at += size;
+  return true;
+}
+
+template <typename T>
+inline T byte_read(ByteReader& in) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  T value;
+  byte_read_bytes(in, &value, sizeof(T));
+  return value;
+}
+
+#endif
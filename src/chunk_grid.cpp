@@ -0,0 +1,39 @@
+#include "chunk_grid.hpp"
+
+#include "world.hpp"
+
+void chunk_grid_resize(ChunkGrid& grid, i32 side) {
+  for (auto* chunk : grid.cells) {
+    if (chunk != nullptr) chunk_grid_unlink(chunk);
+  }
+  grid.side = side;
+  grid.placed = false;
+  grid.cells.assign((size_t)side * side, nullptr);
+}
+
+void chunk_grid_link(ChunkGrid const& grid, Chunk* chunk) {
+  for (int dy = -1; dy <= 1; ++dy) {
+    for (int dx = -1; dx <= 1; ++dx) {
+      if (dx == 0 && dy == 0) continue;
+      auto* neighbour = chunk_grid_find(grid, chunk->x + dx * CHUNK_WIDTH,
+                                        chunk->y + dy * CHUNK_LENGTH);
+      if (neighbour == nullptr) continue;
+      chunk->neighbours[chunk_neighbour_index(dx, dy)] = neighbour;
+      neighbour->neighbours[chunk_neighbour_index(-dx, -dy)] = chunk;
+    }
+  }
+}
+
+void chunk_grid_unlink(Chunk* chunk) {
+  for (int dy = -1; dy <= 1; ++dy) {
+    for (int dx = -1; dx <= 1; ++dx) {
+      if (dx == 0 && dy == 0) continue;
+      auto& link = chunk->neighbours[chunk_neighbour_index(dx, dy)];
+      auto* neighbour = link.exchange(nullptr);
+      if (neighbour == nullptr) continue;
+      Chunk* expected = chunk;
+      neighbour->neighbours[chunk_neighbour_index(-dx, -dy)]
+          .compare_exchange_strong(expected, nullptr);
+    }
+  }
+}
@@ -0,0 +1,105 @@
+#ifndef CHUNK_GRID_HPP
+#define CHUNK_GRID_HPP
+
+#include <algorithm>
+
+#include "common.hpp"
+#include "constants.hpp"
+
+struct Chunk;
+
+// Index in Chunk::neighbours of the chunk `dx`, `dy` chunks away, -1 to 1
+inline u32 chunk_neighbour_index(int dx, int dy) {
+  return (u32)((dy + 1) * 3 + (dx + 1));
+}
+
+inline i32 chunk_grid_wrap(i32 v, i32 side) { return ((v % side) + side) % side; }
+
+// The chunks in the render distance, a square window of `side` chunks that
+// follows the player. The grid is a torus: the chunk at chunk coordinates
+// (cx, cy) is in the cell (cx mod side, cy mod side) wherever the window is,
+// so when the window moves only the row or column of cells it uncovered gets
+// new chunks, and the others keep theirs.
+struct ChunkGrid {
+  i32 side = 0;
+  // block position of the first chunk of the window
+  i32 first_x = 0;
+  i32 first_y = 0;
+  // false until the first chunks are placed
+  bool placed = false;
+  // side * side, nullptr before the first pass
+  vector<Chunk*> cells;
+};
+
+inline bool chunk_grid_contains(ChunkGrid const& grid, i32 x, i32 y) {
+  return grid.placed && x >= grid.first_x &&
+         x < grid.first_x + grid.side * CHUNK_WIDTH && y >= grid.first_y &&
+         y < grid.first_y + grid.side * CHUNK_LENGTH;
+}
+
+// Cell of the chunk at the block position `x`, `y`
+inline size_t chunk_grid_cell(ChunkGrid const& grid, i32 x, i32 y) {
+  return (size_t)chunk_grid_wrap(y / CHUNK_LENGTH, grid.side) * grid.side +
+         chunk_grid_wrap(x / CHUNK_WIDTH, grid.side);
+}
+
+// Empties the grid and unlinks the chunks that were in it
+void chunk_grid_resize(ChunkGrid& grid, i32 side);
+// Links the chunk with the chunks around it in the grid, both ways
+void chunk_grid_link(ChunkGrid const& grid, Chunk* chunk);
+// Unlinks the chunk from its neighbours, both ways
+void chunk_grid_unlink(Chunk* chunk);
+
+// Moves the window to start at the block position `first_x`, `first_y`.
+// `enter(x, y)` returns the chunk for every position that came into the
+// window; the chunks that left it are unlinked from their neighbours. Only
+// the uncovered strip is visited, plus one step per column.
+template <typename F>
+void chunk_grid_move(ChunkGrid& grid, i32 first_x, i32 first_y, F&& enter) {
+  i32 side = grid.side;
+  i32 new_cx = first_x / CHUNK_WIDTH;
+  i32 new_cy = first_y / CHUNK_LENGTH;
+  i32 old_cx = grid.first_x / CHUNK_WIDTH;
+  i32 old_cy = grid.first_y / CHUNK_LENGTH;
+  bool placed = grid.placed;
+  // rows of the new window that were not in the old one, for the columns
+  // that were
+  i32 strip_first = new_cy;
+  i32 strip_end = new_cy + side;
+  if (placed && new_cy >= old_cy) {
+    strip_first = std::max(new_cy, old_cy + side);
+  } else if (placed) {
+    strip_end = std::min(new_cy + side, old_cy);
+  }
+
+  auto place = [&](i32 cx, i32 cy) {
+    i32 x = cx * CHUNK_WIDTH;
+    i32 y = cy * CHUNK_LENGTH;
+    auto& cell = grid.cells[chunk_grid_cell(grid, x, y)];
+    if (cell != nullptr) chunk_grid_unlink(cell);
+    cell = enter(x, y);
+  };
+  for (i32 cx = new_cx; cx < new_cx + side; ++cx) {
+    bool was_in = placed && cx >= old_cx && cx < old_cx + side;
+    i32 first = was_in ? strip_first : new_cy;
+    i32 end = was_in ? strip_end : new_cy + side;
+    for (i32 cy = first; cy < end; ++cy) place(cx, cy);
+  }
+  grid.first_x = first_x;
+  grid.first_y = first_y;
+  grid.placed = true;
+
+  // linked once they are all in the window, so each finds its neighbours
+  for (i32 cx = new_cx; cx < new_cx + side; ++cx) {
+    bool was_in = placed && cx >= old_cx && cx < old_cx + side;
+    i32 first = was_in ? strip_first : new_cy;
+    i32 end = was_in ? strip_end : new_cy + side;
+    for (i32 cy = first; cy < end; ++cy) {
+      auto* chunk =
+          grid.cells[chunk_grid_cell(grid, cx * CHUNK_WIDTH, cy * CHUNK_LENGTH)];
+      if (chunk != nullptr) chunk_grid_link(grid, chunk);
+    }
+  }
+}
+
+#endif
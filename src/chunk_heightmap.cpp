@@ -0,0 +1,17 @@
+#include "chunk_heightmap.hpp"
+
+void chunk_heightmap_build(ChunkHeightmap& heights,
+                           DenseChunkBlocks const& blocks) {
+  heights.max_solid = 0;
+  for (int x = 0; x < CHUNK_WIDTH; ++x) {
+    for (int y = 0; y < CHUNK_LENGTH; ++y) {
+      auto* column = blocks.blocks[x][y];
+      int h = CHUNK_HEIGHT - 1;
+      while (h > 0 && column[h].type == BlockType::Air) h--;
+      heights.solid[x][y] = h;
+      heights.max_solid = std::max(heights.max_solid, (u8)h);
+      while (h > 0 && !is_block_opaque(column[h].type)) h--;
+      heights.opaque[x][y] = h;
+    }
+  }
+}
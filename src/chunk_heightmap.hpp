@@ -0,0 +1,86 @@
+#ifndef CHUNK_HEIGHTMAP_HPP
+#define CHUNK_HEIGHTMAP_HPP
+
+#include <algorithm>
+
+#include "chunk_storage.hpp"
+
+static_assert(CHUNK_HEIGHT <= 256, "ChunkHeightmap heights are stored in bytes");
+
+// Blocks that light does not pass through
+inline bool is_block_opaque(BlockType type) {
+  switch (type) {
+    case BlockType::Air:
+    case BlockType::Water:
+    case BlockType::Leaves:
+    case BlockType::PineTreeLeaves:
+    case BlockType::JungleTreeLeaves:
+      return false;
+    default:
+      return true;
+  }
+}
+
+// The top blocks of the columns of a chunk. Built when the chunk is generated
+// and kept up to date by the edits, so nothing has to scan a column from the
+// top of the world down.
+struct ChunkHeightmap {
+  // height of the top block that is not air, 0 for an empty column
+  u8 solid[CHUNK_WIDTH][CHUNK_LENGTH] = {};
+  // height of the top opaque block, at most `solid`
+  u8 opaque[CHUNK_WIDTH][CHUNK_LENGTH] = {};
+  // no column is higher, everything above it is air. Removing blocks does not
+  // lower it, it only bounds the loops over the heights.
+  u8 max_solid = 0;
+};
+
+inline u32 chunk_heightmap_top_solid(ChunkHeightmap const& heights, int x,
+                                     int y) {
+  return heights.solid[x][y];
+}
+
+inline u32 chunk_heightmap_top_opaque(ChunkHeightmap const& heights, int x,
+                                      int y) {
+  return heights.opaque[x][y];
+}
+
+void chunk_heightmap_build(ChunkHeightmap& heights,
+                           DenseChunkBlocks const& blocks);
+
+// Updates the column at `x`, `y` once its block at `z` has been set to
+// `type`. `get(h)` returns the type of the block of the column at height `h`,
+// it is only called when the top block of the column was removed.
+template <typename F>
+void chunk_heightmap_update(ChunkHeightmap& heights, int x, int y, int z,
+                            BlockType type, F&& get) {
+  auto& solid = heights.solid[x][y];
+  auto& opaque = heights.opaque[x][y];
+  if (type != BlockType::Air) {
+    if (z > solid) solid = z;
+    heights.max_solid = std::max(heights.max_solid, solid);
+  } else if (z == solid) {
+    while (solid > 0 && get(solid) == BlockType::Air) solid--;
+  }
+  if (is_block_opaque(type)) {
+    if (z > opaque) opaque = z;
+  } else if (z == opaque) {
+    while (opaque > 0 && !is_block_opaque(get(opaque))) opaque--;
+  }
+}
+
+inline void chunk_heightmap_update(ChunkHeightmap& heights,
+                                   DenseChunkBlocks const& blocks, int x,
+                                   int y, int z, BlockType type) {
+  chunk_heightmap_update(heights, x, y, z, type,
+                         [&](int h) { return blocks.blocks[x][y][h].type; });
+}
+
+inline void chunk_heightmap_update(ChunkHeightmap& heights,
+                                   ChunkBlocks const& blocks, int x, int y,
+                                   int z, BlockType type) {
+  chunk_heightmap_update(heights, x, y, z, type, [&](int h) {
+    return chunk_blocks_get(blocks, x, y, h).type;
+  });
+}
+
+#endif
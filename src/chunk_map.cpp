@@ -0,0 +1,81 @@
+#include "chunk_map.hpp"
+
+// slots of a new map
+constexpr u64 CHUNK_MAP_MIN_SLOTS = 256;
+
+inline unique_ptr<ChunkMapTable> make_table(u64 slots) {
+  auto table = make_unique<ChunkMapTable>();
+  table->mask = slots - 1;
+  table->slots = make_unique<ChunkMapSlot[]>(slots);
+  return table;
+}
+
+// Finds the slot of `key`, or the empty slot ending its probe sequence
+inline ChunkMapSlot& table_probe(ChunkMapTable& table, u64 key) {
+  for (u64 i = mix64(key) & table.mask;; i = (i + 1) & table.mask) {
+    u64 slot_key = table.slots[i].key.load(std::memory_order_relaxed);
+    if (slot_key == key || slot_key == CHUNK_MAP_EMPTY) return table.slots[i];
+  }
+}
+
+// the chunk is written first, a lookup that sees the key sees the chunk
+inline void slot_store(ChunkMapSlot& slot, u64 key, Chunk* chunk) {
+  slot.chunk.store(chunk, std::memory_order_relaxed);
+  slot.key.store(key, std::memory_order_release);
+}
+
+ChunkMap::ChunkMap() {
+  this->tables.push_back(make_table(CHUNK_MAP_MIN_SLOTS));
+  this->table = this->tables.back().get();
+}
+
+// Moves the chunks into a table with no erased slots, at most a quarter full
+void chunk_map_rebuild(ChunkMap& map) {
+  u64 slots = CHUNK_MAP_MIN_SLOTS;
+  while (slots < map.count * 4) slots *= 2;
+  auto table = make_table(slots);
+  chunk_map_for_each(map, [&](ChunkId id, Chunk* chunk) {
+    u64 key = chunk_map_key(id);
+    slot_store(table_probe(*table, key), key, chunk);
+    table->used++;
+  });
+  map.table.store(table.get(), std::memory_order_release);
+  map.tables.push_back(std::move(table));
+  map.rebuilds++;
+}
+
+bool chunk_map_insert(ChunkMap& map, ChunkId id, Chunk* chunk) {
+  auto* table = map.table.load(std::memory_order_relaxed);
+  // at most three quarters of the slots used, for short probe sequences
+  if ((table->used + 1) * 4 > (table->mask + 1) * 3) {
+    chunk_map_rebuild(map);
+    table = map.table.load(std::memory_order_relaxed);
+  }
+  u64 key = chunk_map_key(id);
+  auto& slot = table_probe(*table, key);
+  if (slot.key.load(std::memory_order_relaxed) == key) return false;
+  slot_store(slot, key, chunk);
+  table->used++;
+  map.count++;
+  return true;
+}
+
+bool chunk_map_erase(ChunkMap& map, ChunkId id) {
+  auto* table = map.table.load(std::memory_order_relaxed);
+  u64 key = chunk_map_key(id);
+  auto& slot = table_probe(*table, key);
+  if (slot.key.load(std::memory_order_relaxed) != key) return false;
+  slot.key.store(CHUNK_MAP_ERASED, std::memory_order_release);
+  map.count--;
+  return true;
+}
+
+void chunk_map_clear(ChunkMap& map) {
+  map.tables.push_back(make_table(CHUNK_MAP_MIN_SLOTS));
+  map.table.store(map.tables.back().get(), std::memory_order_release);
+  map.count = 0;
+}
+
+void chunk_map_reclaim(ChunkMap& map) {
+  map.tables.erase(map.tables.begin(), map.tables.end() - 1);
+}
@@ -0,0 +1,88 @@
+#ifndef CHUNK_MAP_HPP
+#define CHUNK_MAP_HPP
+
+#include <atomic>
+
+#include "util.hpp"
+
+struct Chunk;
+
+// Chunk positions packed into a table key. Chunk positions are multiples of
+// the chunk size, so the two keys below are never chunk positions.
+constexpr u64 CHUNK_MAP_EMPTY = ~0ull;
+// an erased key, skipped by lookups until the table is rebuilt
+constexpr u64 CHUNK_MAP_ERASED = ~0ull - 1;
+
+inline u64 chunk_map_key(ChunkId id) {
+  return (u64)(u32)id.first << 32 | (u32)id.second;
+}
+
+inline ChunkId chunk_map_id(u64 key) {
+  return ChunkId{(i32)(u32)(key >> 32), (i32)(u32)key};
+}
+
+struct ChunkMapSlot {
+  std::atomic<u64> key = CHUNK_MAP_EMPTY;
+  std::atomic<Chunk*> chunk = nullptr;
+};
+
+// Open addressing, linear probing. A slot is never reused once it held a key,
+// so a reader that matched a key never reads the chunk of another one; erased
+// slots are dropped when the table is rebuilt.
+struct ChunkMapTable {
+  u64 mask = 0;
+  unique_ptr<ChunkMapSlot[]> slots;
+  // slots holding a key, erased ones included
+  u64 used = 0;
+};
+
+// The loaded chunks by position. Lookups take no lock and may run at any time;
+// inserting, erasing and iterating are serialized by the caller. A rebuilt
+// table replaces the current one, and the old one is kept for the lookups
+// that may still be walking it until chunk_map_reclaim.
+struct ChunkMap {
+  std::atomic<ChunkMapTable*> table = nullptr;
+  // the current table last
+  vector<unique_ptr<ChunkMapTable>> tables;
+  std::atomic<u64> count = 0;
+
+  // statistics
+  std::atomic<u64> rebuilds = 0;
+
+  ChunkMap();
+};
+
+inline Chunk* chunk_map_find(ChunkMap const& map, ChunkId id) {
+  auto* table = map.table.load(std::memory_order_acquire);
+  u64 key = chunk_map_key(id);
+  for (u64 i = mix64(key) & table->mask;; i = (i + 1) & table->mask) {
+    u64 slot_key = table->slots[i].key.load(std::memory_order_acquire);
+    if (slot_key == key) {
+      return table->slots[i].chunk.load(std::memory_order_acquire);
+    }
+    if (slot_key == CHUNK_MAP_EMPTY) return nullptr;
+  }
+}
+
+// Returns false when there is a chunk at `id` already
+bool chunk_map_insert(ChunkMap& map, ChunkId id, Chunk* chunk);
+bool chunk_map_erase(ChunkMap& map, ChunkId id);
+void chunk_map_clear(ChunkMap& map);
+// Frees the tables that were replaced. No lookup may be running.
+void chunk_map_reclaim(ChunkMap& map);
+
+inline size_t chunk_map_size(ChunkMap const& map) { return map.count; }
+
+// Calls `f(ChunkId, Chunk*)` for every chunk
+template <typename F>
+void chunk_map_for_each(ChunkMap const& map, F&& f) {
+  auto* table = map.table.load(std::memory_order_acquire);
+  for (u64 i = 0; i <= table->mask; ++i) {
+    auto& slot = table->slots[i];
+    u64 key = slot.key.load(std::memory_order_relaxed);
+    if (key == CHUNK_MAP_EMPTY || key == CHUNK_MAP_ERASED) continue;
+    f(chunk_map_id(key), slot.chunk.load(std::memory_order_relaxed));
+  }
+}
+
+#endif
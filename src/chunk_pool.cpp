@@ -0,0 +1,159 @@
+#include "chunk_pool.hpp"
+
+#include <algorithm>
+
+#include "logger.hpp"
+
+u32 chunk_pool_default_size() {
+  u32 n = std::thread::hardware_concurrency();
+  return n > 1 ? n - 1 : 1;
+}
+
+inline bool chunk_pool_in_region(ChunkGenPool& pool, ChunkJob& job) {
+  return job.x >= pool.first_x && job.x <= pool.last_x &&
+         job.y >= pool.first_y && job.y <= pool.last_y;
+}
+
+// Takes the next job of worker `index`, or steals one from another worker
+bool chunk_pool_take(ChunkGenPool& pool, u32 index, ChunkJob& job) {
+  u32 n = pool.queues.size();
+  for (u32 i = 0; i < n; ++i) {
+    auto& queue = *pool.queues[(index + i) % n];
+    std::lock_guard<std::mutex> guard(queue.mutex);
+    if (queue.jobs.empty()) continue;
+    job = queue.jobs.front();
+    queue.jobs.pop_front();
+    pool.running++;
+    pool.queued--;
+    pool.queues[index]->running_job = ++pool.jobs_started;
+    if (i != 0) pool.jobs_stolen++;
+    return true;
+  }
+  return false;
+}
+
+void chunk_pool_worker(ChunkGenPool& pool, u32 index) {
+  while (true) {
+    ChunkJob job;
+    if (!chunk_pool_take(pool, index, job)) {
+      std::unique_lock<std::mutex> lock(pool.wake_mutex);
+      pool.wake.wait(lock, [&] { return pool.stopping || pool.queued > 0; });
+      if (pool.stopping) return;
+      continue;
+    }
+    // the player moved away since the job was queued
+    if (chunk_pool_in_region(pool, job)) {
+      pool.run(job);
+      pool.jobs_done++;
+    } else {
+      pool.cancel(job);
+      pool.jobs_cancelled++;
+    }
+    pool.queues[index]->running_job = 0;
+    {
+      std::lock_guard<std::mutex> guard(pool.wake_mutex);
+      pool.running--;
+    }
+    pool.idle.notify_all();
+  }
+}
+
+void chunk_pool_start(ChunkGenPool& pool, u32 nworkers,
+                      std::function<void(ChunkJob&)> run,
+                      std::function<void(ChunkJob&)> cancel) {
+  pool.run = std::move(run);
+  pool.cancel = std::move(cancel);
+  pool.stopping = false;
+  for (u32 i = 0; i < nworkers; ++i) {
+    pool.queues.push_back(make_unique<ChunkJobQueue>());
+  }
+  for (u32 i = 0; i < nworkers; ++i) {
+    pool.workers.emplace_back(chunk_pool_worker, std::ref(pool), i);
+  }
+  logger::info(fmt::format("Started {} chunk generation workers", nworkers));
+}
+
+void chunk_pool_stop(ChunkGenPool& pool) {
+  if (pool.workers.empty()) return;
+  chunk_pool_clear(pool);
+  {
+    std::lock_guard<std::mutex> guard(pool.wake_mutex);
+    pool.stopping = true;
+  }
+  pool.wake.notify_all();
+  for (auto& worker : pool.workers) worker.join();
+  pool.workers.clear();
+  pool.queues.clear();
+}
+
+ChunkGenPool::~ChunkGenPool() { chunk_pool_stop(*this); }
+
+void chunk_pool_set_region(ChunkGenPool& pool, i32 first_x, i32 first_y,
+                           i32 last_x, i32 last_y) {
+  pool.first_x = first_x;
+  pool.first_y = first_y;
+  pool.last_x = last_x;
+  pool.last_y = last_y;
+}
+
+void chunk_pool_submit(ChunkGenPool& pool, vector<ChunkJob> jobs) {
+  if (jobs.empty()) return;
+  std::sort(jobs.begin(), jobs.end(),
+            [](ChunkJob const& a, ChunkJob const& b) {
+              return a.priority < b.priority;
+            });
+  // counted before they are visible, so `queued` never drops below zero
+  pool.queued += jobs.size();
+  // deal the jobs round-robin so every queue starts with urgent ones
+  u32 n = pool.queues.size();
+  for (u32 q = 0; q < n; ++q) {
+    auto& queue = *pool.queues[q];
+    std::lock_guard<std::mutex> guard(queue.mutex);
+    for (size_t i = q; i < jobs.size(); i += n) {
+      queue.jobs.push_back(jobs[i]);
+    }
+    // merge with the jobs that were already queued
+    std::stable_sort(queue.jobs.begin(), queue.jobs.end(),
+                     [](ChunkJob const& a, ChunkJob const& b) {
+                       return a.priority < b.priority;
+                     });
+  }
+  { std::lock_guard<std::mutex> guard(pool.wake_mutex); }
+  pool.wake.notify_all();
+}
+
+void chunk_pool_clear(ChunkGenPool& pool) {
+  for (auto& queue : pool.queues) {
+    std::deque<ChunkJob> dropped;
+    {
+      std::lock_guard<std::mutex> guard(queue->mutex);
+      dropped.swap(queue->jobs);
+      pool.queued -= dropped.size();
+    }
+    for (auto& job : dropped) {
+      if (!chunk_pool_in_region(pool, job)) pool.jobs_cancelled++;
+      pool.cancel(job);
+    }
+  }
+}
+
+void chunk_pool_drain(ChunkGenPool& pool) {
+  chunk_pool_clear(pool);
+  std::unique_lock<std::mutex> lock(pool.wake_mutex);
+  pool.idle.wait(lock, [&] { return pool.running == 0; });
+}
+
+void chunk_pool_wait(ChunkGenPool& pool) {
+  std::unique_lock<std::mutex> lock(pool.wake_mutex);
+  // a job is counted as running before it stops being queued, so both are
+  // only zero once all of them are done
+  pool.idle.wait(lock, [&] { return pool.queued == 0 && pool.running == 0; });
+}
+
+bool chunk_pool_finished_up_to(ChunkGenPool& pool, u64 job) {
+  for (auto& queue : pool.queues) {
+    u64 running = queue->running_job;
+    if (running != 0 && running <= job) return false;
+  }
+  return true;
+}
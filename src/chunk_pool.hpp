@@ -0,0 +1,84 @@
+#ifndef CHUNK_POOL_HPP
+#define CHUNK_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "common.hpp"
+
+struct Chunk;
+
+// Generation and meshing of one chunk
+struct ChunkJob {
+  Chunk* chunk;
+  i32 x;
+  i32 y;
+  // lower runs first
+  float priority;
+};
+
+// Jobs of one worker, in priority order. The owner and the workers stealing
+// from it both take the most urgent job first.
+struct ChunkJobQueue {
+  std::mutex mutex;
+  std::deque<ChunkJob> jobs;
+  // number of the job the worker is running, 0 when it is idle
+  std::atomic<u64> running_job = 0;
+};
+
+// Chunk generation workers with a job queue each. Idle workers steal from the
+// others, so a burst of jobs is spread over all the cores.
+struct ChunkGenPool {
+  vector<std::thread> workers;
+  vector<unique_ptr<ChunkJobQueue>> queues;
+  std::function<void(ChunkJob&)> run;
+  // called instead of `run` for jobs that are dropped
+  std::function<void(ChunkJob&)> cancel;
+
+  // jobs for chunks outside of this region are cancelled instead of started
+  std::atomic<i32> first_x = 0;
+  std::atomic<i32> first_y = 0;
+  std::atomic<i32> last_x = -1;
+  std::atomic<i32> last_y = -1;
+
+  std::mutex wake_mutex;
+  std::condition_variable wake;
+  std::condition_variable idle;
+  std::atomic<u32> queued = 0;
+  std::atomic<u32> running = 0;
+  std::atomic<bool> stopping = false;
+  // jobs are numbered from 1 as they start
+  std::atomic<u64> jobs_started = 0;
+
+  // statistics
+  std::atomic<u64> jobs_done = 0;
+  std::atomic<u64> jobs_cancelled = 0;
+  std::atomic<u64> jobs_stolen = 0;
+
+  ~ChunkGenPool();
+};
+
+// one worker per hardware thread, leaving one for the render thread
+u32 chunk_pool_default_size();
+void chunk_pool_start(ChunkGenPool& pool, u32 nworkers,
+                      std::function<void(ChunkJob&)> run,
+                      std::function<void(ChunkJob&)> cancel);
+void chunk_pool_stop(ChunkGenPool& pool);
+void chunk_pool_set_region(ChunkGenPool& pool, i32 first_x, i32 first_y,
+                           i32 last_x, i32 last_y);
+// Queues the jobs, dealt over the workers in priority order
+void chunk_pool_submit(ChunkGenPool& pool, vector<ChunkJob> jobs);
+// Cancels the jobs that have not started yet
+void chunk_pool_clear(ChunkGenPool& pool);
+// Cancels the queued jobs and waits for the running ones to finish
+void chunk_pool_drain(ChunkGenPool& pool);
+// Waits for all the queued and running jobs to finish
+void chunk_pool_wait(ChunkGenPool& pool);
+// Whether the jobs numbered up to `job` have all finished, so none of them
+// can still hold a chunk it found before then
+bool chunk_pool_finished_up_to(ChunkGenPool& pool, u64 job);
+
+#endif
@@ -0,0 +1,113 @@
+#include "chunk_scheduler.hpp"
+
+#include <algorithm>
+
+#include "util.hpp"
+
+// cosine of the angle the player has to turn by to re-prioritize the jobs
+constexpr float VIEW_TURN_COS = 0.7f;
+
+void chunk_scheduler_run(ChunkScheduler& scheduler) {
+  while (true) {
+    ChunkSchedulerInput input;
+    {
+      std::unique_lock<std::mutex> lock(scheduler.mutex);
+      scheduler.wake.wait(
+          lock, [&] { return scheduler.stopping || scheduler.events != 0; });
+      if (scheduler.stopping) return;
+      scheduler.events = 0;
+      input = scheduler.input;
+      scheduler.scheduled_view_dir = input.view_dir;
+    }
+    scheduler.pass(input);
+    scheduler.passes++;
+  }
+}
+
+void chunk_scheduler_start(ChunkScheduler& scheduler, ChunkSchedulerInput input,
+                           std::function<void(ChunkSchedulerInput const&)> pass) {
+  scheduler.pass = std::move(pass);
+  scheduler.input = input;
+  scheduler.scheduled_view_dir = input.view_dir;
+  scheduler.stopping = false;
+  // the first pass fills the whole radius
+  scheduler.events = ChunkEvent::PlayerMoved;
+  scheduler.thread = std::thread(chunk_scheduler_run, std::ref(scheduler));
+}
+
+void chunk_scheduler_stop(ChunkScheduler& scheduler) {
+  if (!scheduler.thread.joinable()) return;
+  {
+    std::lock_guard<std::mutex> guard(scheduler.mutex);
+    scheduler.stopping = true;
+  }
+  scheduler.wake.notify_one();
+  scheduler.thread.join();
+}
+
+ChunkScheduler::~ChunkScheduler() { chunk_scheduler_stop(*this); }
+
+void chunk_scheduler_notify(ChunkScheduler& scheduler, u32 events) {
+  {
+    std::lock_guard<std::mutex> guard(scheduler.mutex);
+    scheduler.events |= events;
+  }
+  scheduler.wake.notify_one();
+}
+
+void chunk_scheduler_update_player(ChunkScheduler& scheduler,
+                                   glm::ivec3 player_pos, vec3 view_dir) {
+  u32 events = 0;
+  {
+    std::lock_guard<std::mutex> guard(scheduler.mutex);
+    auto& last = scheduler.input.player_pos;
+    // the loading window is centred on the position rounded to 16 blocks
+    if (round_to_nearest_16(player_pos.x) != round_to_nearest_16(last.x) ||
+        round_to_nearest_16(player_pos.z) != round_to_nearest_16(last.z)) {
+      events |= ChunkEvent::PlayerMoved;
+    }
+    vec2 view{view_dir.x, view_dir.z};
+    vec2 scheduled{scheduler.scheduled_view_dir.x,
+                   scheduler.scheduled_view_dir.z};
+    if (glm::length(view) > 0.0f && glm::length(scheduled) > 0.0f &&
+        glm::dot(glm::normalize(view), glm::normalize(scheduled)) <
+            VIEW_TURN_COS) {
+      events |= ChunkEvent::ViewTurned;
+    }
+    scheduler.input.player_pos = player_pos;
+    scheduler.input.view_dir = view_dir;
+    if (events == 0) return;
+    scheduler.events |= events;
+  }
+  scheduler.wake.notify_one();
+}
+
+void chunk_scheduler_set_rendering_distance(ChunkScheduler& scheduler,
+                                            u32 rendering_distance) {
+  {
+    std::lock_guard<std::mutex> guard(scheduler.mutex);
+    scheduler.input.rendering_distance = rendering_distance;
+    scheduler.events |= ChunkEvent::RenderDistanceChanged;
+  }
+  scheduler.wake.notify_one();
+}
+
+void chunk_latency_record(ChunkLatencyStats& stats,
+                          ChunkClock::time_point since) {
+  float ms = std::chrono::duration<float, std::milli>(ChunkClock::now() - since)
+                 .count();
+  stats.recent[stats.count % stats.recent.size()] = ms;
+  stats.count++;
+  stats.last_ms = ms;
+  stats.max_ms = std::max(stats.max_ms, ms);
+  stats.total_ms += ms;
+}
+
+float chunk_latency_percentile(ChunkLatencyStats const& stats, float p) {
+  size_t n = std::min<size_t>(stats.count, stats.recent.size());
+  if (n == 0) return 0.0f;
+  auto sorted = stats.recent;
+  auto nth = sorted.begin() + (size_t)(p * (float)(n - 1));
+  std::nth_element(sorted.begin(), nth, sorted.begin() + n);
+  return *nth;
+}
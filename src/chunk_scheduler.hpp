@@ -0,0 +1,83 @@
+#ifndef CHUNK_SCHEDULER_HPP
+#define CHUNK_SCHEDULER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "common.hpp"
+
+// Reasons to run a chunk loading pass
+enum ChunkEvent : u32 {
+  // the loading window moved with the player
+  PlayerMoved = 1 << 0,
+  // the player turned far enough for the job priorities to change
+  ViewTurned = 1 << 1,
+  RenderDistanceChanged = 1 << 2,
+  BlockEdited = 1 << 3,
+  // structure blocks spilled into chunks that are already loaded
+  ChunksStale = 1 << 4,
+  ChunksReset = 1 << 5,
+  // the loaded chunks have to be meshed again, their blocks are kept
+  MeshingChanged = 1 << 6,
+};
+
+// What a loading pass is run for
+struct ChunkSchedulerInput {
+  glm::ivec3 player_pos;
+  vec3 view_dir;
+  u32 rendering_distance;
+};
+
+// Runs the chunk loading pass on its own thread, only when one of the
+// ChunkEvent happens
+struct ChunkScheduler {
+  std::thread thread;
+  std::function<void(ChunkSchedulerInput const&)> pass;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  // pending ChunkEvent bits
+  u32 events = 0;
+  bool stopping = false;
+  ChunkSchedulerInput input;
+  // view direction the queued jobs were prioritized for
+  vec3 scheduled_view_dir;
+
+  // statistics
+  std::atomic<u64> passes = 0;
+
+  ~ChunkScheduler();
+};
+
+void chunk_scheduler_start(ChunkScheduler& scheduler, ChunkSchedulerInput input,
+                           std::function<void(ChunkSchedulerInput const&)> pass);
+void chunk_scheduler_stop(ChunkScheduler& scheduler);
+void chunk_scheduler_notify(ChunkScheduler& scheduler, u32 events);
+// Called every frame, wakes the scheduler when the loading window moved or the
+// player turned
+void chunk_scheduler_update_player(ChunkScheduler& scheduler,
+                                   glm::ivec3 player_pos, vec3 view_dir);
+void chunk_scheduler_set_rendering_distance(ChunkScheduler& scheduler,
+                                            u32 rendering_distance);
+
+using ChunkClock = std::chrono::steady_clock;
+
+// Time from a chunk entering the render radius to its mesh being uploaded
+struct ChunkLatencyStats {
+  u64 count = 0;
+  float last_ms = 0.0f;
+  float max_ms = 0.0f;
+  double total_ms = 0.0;
+  // the most recent samples, for the percentiles
+  std::array<float, 512> recent{};
+};
+
+void chunk_latency_record(ChunkLatencyStats& stats, ChunkClock::time_point since);
+// p in [0, 1], over the recent samples
+float chunk_latency_percentile(ChunkLatencyStats const& stats, float p);
+
+#endif
@@ -0,0 +1,82 @@
+#include "chunk_slab.hpp"
+
+#include <algorithm>
+#include <new>
+
+#include "world.hpp"
+
+constexpr std::align_val_t CHUNK_ALIGN{alignof(Chunk)};
+
+inline void recycle_chunk(Chunk* chunk) {
+  delete chunk->mesh;
+  chunk->~Chunk();
+  new (chunk) Chunk();
+}
+
+inline void free_slab(Chunk* slab) {
+  for (u32 i = 0; i < CHUNK_SLAB_CHUNKS; ++i) {
+    // the meshes of the chunks still loaded when the world goes away
+    delete slab[i].mesh;
+    slab[i].~Chunk();
+  }
+  ::operator delete(slab, CHUNK_ALIGN);
+}
+
+ChunkSlabs::~ChunkSlabs() {
+  for (auto* slab : this->slabs) free_slab(slab);
+}
+
+Chunk* chunk_slab_acquire(ChunkSlabs& slabs) {
+  std::lock_guard<std::mutex> guard(slabs.mutex);
+  if (slabs.free.empty()) {
+    auto* slab = static_cast<Chunk*>(
+        ::operator new(sizeof(Chunk) * CHUNK_SLAB_CHUNKS, CHUNK_ALIGN));
+    for (u32 i = 0; i < CHUNK_SLAB_CHUNKS; ++i) new (slab + i) Chunk();
+    slabs.slabs.push_back(slab);
+    for (u32 i = CHUNK_SLAB_CHUNKS; i > 0; --i) slabs.free.push_back(slab + i - 1);
+  }
+  auto* chunk = slabs.free.back();
+  slabs.free.pop_back();
+  slabs.free_chunks = slabs.free.size();
+  u64 live = ++slabs.live;
+  if (live > slabs.peak) slabs.peak = live;
+  return chunk;
+}
+
+void chunk_slab_release(ChunkSlabs& slabs, Chunk* chunk) {
+  // the blocks and the mesh are freed outside of the lock
+  recycle_chunk(chunk);
+  std::lock_guard<std::mutex> guard(slabs.mutex);
+  auto& free = slabs.free;
+  free.insert(std::lower_bound(free.begin(), free.end(), chunk,
+                               std::greater<Chunk*>()),
+              chunk);
+  slabs.free_chunks = slabs.free.size();
+  slabs.live--;
+}
+
+void chunk_slab_trim(ChunkSlabs& slabs) {
+  std::lock_guard<std::mutex> guard(slabs.mutex);
+  auto& free = slabs.free;
+  auto kept = slabs.slabs.begin();
+  for (auto* slab : slabs.slabs) {
+    auto first = std::lower_bound(free.begin(), free.end(),
+                                  slab + CHUNK_SLAB_CHUNKS - 1,
+                                  std::greater<Chunk*>());
+    auto last = std::upper_bound(first, free.end(), slab,
+                                 std::greater<Chunk*>());
+    if (last - first < CHUNK_SLAB_CHUNKS) {
+      *kept++ = slab;
+      continue;
+    }
+    free.erase(first, last);
+    free_slab(slab);
+    slabs.slabs_trimmed++;
+  }
+  slabs.slabs.erase(kept, slabs.slabs.end());
+  slabs.free_chunks = free.size();
+}
+
+size_t chunk_slab_bytes(ChunkSlabs const& slabs) {
+  return (slabs.live + slabs.free_chunks) * sizeof(Chunk);
+}
@@ -0,0 +1,46 @@
+#ifndef CHUNK_SLAB_HPP
+#define CHUNK_SLAB_HPP
+
+#include <atomic>
+#include <mutex>
+
+#include "common.hpp"
+
+struct Chunk;
+
+// chunks allocated at once
+constexpr u32 CHUNK_SLAB_CHUNKS = 64;
+
+// Storage of the chunks. Chunks are allocated CHUNK_SLAB_CHUNKS at a time and
+// recycled when they leave the render distance, so moving around reuses the
+// same memory. A chunk is destroyed and constructed again when it is
+// released, so it may only be released once no other thread can still hold
+// a pointer to it, see free_unloaded_chunks.
+struct ChunkSlabs {
+  std::mutex mutex;
+  vector<Chunk*> slabs;
+  // reset chunks, ready to be handed out, highest address first. The lowest
+  // is handed out first, which packs the live chunks into the lowest slabs
+  // and leaves the others empty to be trimmed.
+  vector<Chunk*> free;
+
+  // statistics
+  std::atomic<u64> live = 0;
+  std::atomic<u64> free_chunks = 0;
+  std::atomic<u64> peak = 0;
+  std::atomic<u64> slabs_trimmed = 0;
+
+  ~ChunkSlabs();
+};
+
+// A new chunk, as `new Chunk()` would return it
+Chunk* chunk_slab_acquire(ChunkSlabs& slabs);
+// Frees the blocks and the mesh of the chunk and puts it back in the free
+// list. No job may be queued or running for it, and no other thread may hold
+// a pointer to it anymore.
+void chunk_slab_release(ChunkSlabs& slabs, Chunk* chunk);
+// Returns the slabs whose chunks are all free to the system
+void chunk_slab_trim(ChunkSlabs& slabs);
+size_t chunk_slab_bytes(ChunkSlabs const& slabs);
+
+#endif
@@ -0,0 +1,197 @@
+#include "chunk_storage.hpp"
+
+#include <algorithm>
+
+// smallest index width for `n` palette entries
+inline u8 palette_bits(size_t n) {
+  if (n <= 2) return 1;
+  if (n <= 4) return 2;
+  if (n <= 16) return 4;
+  return 8;
+}
+
+inline void section_write_slot(BlockSection& section, u32 index, u32 slot) {
+  u32 bit = index * section.bits;
+  u64 mask = ((1ull << section.bits) - 1) << (bit % 64);
+  auto& word = section.data[bit / 64];
+  word = (word & ~mask) | ((u64)slot << (bit % 64));
+}
+
+// Widens the indices of the section to `bits`
+void section_repack(BlockSection& section, u8 bits) {
+  BlockSection wider;
+  wider.bits = bits;
+  wider.data.assign(SECTION_BLOCKS * bits / 64, 0);
+  u32 mask = (1u << section.bits) - 1;
+  for (u32 i = 0; i < SECTION_BLOCKS; ++i) {
+    u32 bit = i * section.bits;
+    u32 slot = (section.data[bit / 64] >> (bit % 64)) & mask;
+    section_write_slot(wider, i, slot);
+  }
+  section.data = std::move(wider.data);
+  section.bits = bits;
+}
+
+void block_section_set(BlockSection& section, u32 index, BlockType type) {
+  if (section.bits == 0) {
+    if (type == section.uniform) return;
+    section.palette = {section.uniform};
+    section.bits = 1;
+    section.data.assign(SECTION_BLOCKS / 64, 0);
+  }
+  auto it = std::find(section.palette.begin(), section.palette.end(), type);
+  u32 slot = it - section.palette.begin();
+  if (it == section.palette.end()) {
+    section.palette.push_back(type);
+    u8 bits = palette_bits(section.palette.size());
+    if (bits != section.bits) section_repack(section, bits);
+  }
+  section_write_slot(section, index, slot);
+}
+
+void chunk_blocks_pack(DenseChunkBlocks const& dense, ChunkBlocks& blocks) {
+  // palette slot of each block type, 0xff when not in the palette yet
+  std::array<u8, 256> slots;
+  for (u32 s = 0; s < CHUNK_SECTIONS; ++s) {
+    auto& section = blocks.sections[s];
+    int z0 = s * CHUNK_SECTION_HEIGHT;
+    slots.fill(0xff);
+    section.palette.clear();
+    for (int x = 0; x < CHUNK_WIDTH; ++x) {
+      for (int y = 0; y < CHUNK_LENGTH; ++y) {
+        auto* column = &dense.blocks[x][y][z0];
+        for (int z = 0; z < CHUNK_SECTION_HEIGHT; ++z) {
+          auto& slot = slots[(u8)column[z].type];
+          if (slot != 0xff) continue;
+          slot = section.palette.size();
+          section.palette.push_back(column[z].type);
+        }
+      }
+    }
+
+    if (section.palette.size() == 1) {
+      section.uniform = section.palette[0];
+      section.bits = 0;
+      section.palette = {};
+      section.data = {};
+      continue;
+    }
+    section.bits = palette_bits(section.palette.size());
+    section.palette.shrink_to_fit();
+    section.data.assign(SECTION_BLOCKS * section.bits / 64, 0);
+    section.data.shrink_to_fit();
+    u32 index = 0;
+    for (int x = 0; x < CHUNK_WIDTH; ++x) {
+      for (int y = 0; y < CHUNK_LENGTH; ++y) {
+        auto* column = &dense.blocks[x][y][z0];
+        for (int z = 0; z < CHUNK_SECTION_HEIGHT; ++z, ++index) {
+          u32 bit = index * section.bits;
+          section.data[bit / 64] |= (u64)slots[(u8)column[z].type]
+                                    << (bit % 64);
+        }
+      }
+    }
+  }
+}
+
+void chunk_blocks_unpack(ChunkBlocks const& blocks, DenseChunkBlocks& dense) {
+  for (u32 s = 0; s < CHUNK_SECTIONS; ++s) {
+    auto& section = blocks.sections[s];
+    int z0 = s * CHUNK_SECTION_HEIGHT;
+    for (int x = 0; x < CHUNK_WIDTH; ++x) {
+      for (int y = 0; y < CHUNK_LENGTH; ++y) {
+        auto* column = &dense.blocks[x][y][z0];
+        if (section.bits == 0) {
+          std::fill(column, column + CHUNK_SECTION_HEIGHT,
+                    Block{section.uniform});
+          continue;
+        }
+        for (int z = 0; z < CHUNK_SECTION_HEIGHT; ++z) {
+          column[z].type =
+              block_section_get(section, section_block_index(x, y, z));
+        }
+      }
+    }
+  }
+}
+
+void chunk_blocks_write(ChunkBlocks const& blocks, vector<u8>& out) {
+  for (auto& section : blocks.sections) {
+    byte_write(out, section.bits);
+    byte_write(out, section.uniform);
+    if (section.bits == 0) continue;
+    byte_write(out, (u16)section.palette.size());
+    byte_write_bytes(out, section.palette.data(),
+                     section.palette.size() * sizeof(BlockType));
+    byte_write_bytes(out, section.data.data(),
+                     section.data.size() * sizeof(u64));
+  }
+}
+
+// Whether every index packed in the section is below `size`
+bool section_slots_below(BlockSection const& section, u32 size) {
+  u64 mask = (1ull << section.bits) - 1;
+  for (u64 word : section.data) {
+    for (u32 bit = 0; bit < 64; bit += section.bits) {
+      if (((word >> bit) & mask) >= size) return false;
+    }
+  }
+  return true;
+}
+
+bool chunk_blocks_read(ByteReader& in, ChunkBlocks& blocks) {
+  for (auto& section : blocks.sections) {
+    section.bits = byte_read<u8>(in);
+    section.uniform = byte_read<BlockType>(in);
+    section.palette = {};
+    section.data = {};
+    if (section.bits == 0) continue;
+    if (section.bits != 1 && section.bits != 2 && section.bits != 4 &&
+        section.bits != 8) {
+      return false;
+    }
+    u16 palette_size = byte_read<u16>(in);
+    if (palette_size == 0 || palette_size > 1u << section.bits) return false;
+    section.palette.resize(palette_size);
+    byte_read_bytes(in, section.palette.data(),
+                    palette_size * sizeof(BlockType));
+    section.data.resize(SECTION_BLOCKS * section.bits / 64);
+    byte_read_bytes(in, section.data.data(),
+                    section.data.size() * sizeof(u64));
+    // a damaged payload would index past the palette when unpacked
+    if (palette_size < 1u << section.bits &&
+        !section_slots_below(section, palette_size)) {
+      return false;
+    }
+  }
+  return !in.failed;
+}
+
+DenseChunkBlocks& dense_blocks_scratch() {
+  thread_local auto scratch = make_unique<DenseChunkBlocks>();
+  return *scratch;
+}
+
+size_t chunk_blocks_bytes(ChunkBlocks const& blocks) {
+  size_t bytes = sizeof(ChunkBlocks);
+  for (auto& section : blocks.sections) {
+    bytes += section.palette.capacity() * sizeof(BlockType) +
+             section.data.capacity() * sizeof(u64);
+  }
+  return bytes;
+}
+
+void chunk_blocks_add_stats(ChunkBlocksStats& stats,
+                            ChunkBlocks const& blocks) {
+  stats.bytes += chunk_blocks_bytes(blocks);
+  stats.dense_bytes += sizeof(DenseChunkBlocks);
+  for (auto& section : blocks.sections) {
+    if (section.bits != 0) {
+      stats.palette_sections++;
+    } else if (section.uniform == BlockType::Air) {
+      stats.air_sections++;
+    } else {
+      stats.uniform_sections++;
+    }
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef CHUNK_STORAGE_HPP
+#define CHUNK_STORAGE_HPP
+
+#include <array>
+
+#include "block.hpp"
+#include "byte_stream.hpp"
+
+constexpr u32 SECTION_BLOCKS = CHUNK_WIDTH * CHUNK_LENGTH * CHUNK_SECTION_HEIGHT;
+
+// The blocks of a chunk as one array, indexed by [x][y][height]. Chunks are
+// generated and meshed in this form, and stored packed in ChunkBlocks.
+struct DenseChunkBlocks {
+  Block blocks[CHUNK_WIDTH][CHUNK_LENGTH][CHUNK_HEIGHT];
+};
+
+// CHUNK_SECTION_HEIGHT layers of the blocks of a chunk. A section of one block
+// type (the air above the ground, the stone deep below) stores that type
+// only; the others store the block types they contain in a palette and an
+// index into it per block, packed in 1, 2, 4 or 8 bits.
+struct BlockSection {
+  vector<BlockType> palette;
+  // 64 / bits indices per word, none straddles two words
+  vector<u64> data;
+  // 0 when every block is `uniform`, the vectors are empty then
+  u8 bits = 0;
+  BlockType uniform = BlockType::Air;
+};
+
+struct ChunkBlocks {
+  std::array<BlockSection, CHUNK_SECTIONS> sections;
+};
+
+// Index of a block in its section, the heights of a column are contiguous
+inline u32 section_block_index(int x, int y, int z) {
+  return ((u32)x * CHUNK_LENGTH + (u32)y) * CHUNK_SECTION_HEIGHT +
+         (u32)(z % CHUNK_SECTION_HEIGHT);
+}
+
+inline BlockType block_section_get(BlockSection const& section, u32 index) {
+  if (section.bits == 0) return section.uniform;
+  u32 bit = index * section.bits;
+  u64 word = section.data[bit / 64];
+  u32 slot = (word >> (bit % 64)) & ((1u << section.bits) - 1);
+  return section.palette[slot];
+}
+
+void block_section_set(BlockSection& section, u32 index, BlockType type);
+
+inline Block chunk_blocks_get(ChunkBlocks const& blocks, int x, int y, int z) {
+  auto& section = blocks.sections[z / CHUNK_SECTION_HEIGHT];
+  return Block{block_section_get(section, section_block_index(x, y, z))};
+}
+
+inline void chunk_blocks_set(ChunkBlocks& blocks, int x, int y, int z,
+                             BlockType type) {
+  block_section_set(blocks.sections[z / CHUNK_SECTION_HEIGHT],
+                    section_block_index(x, y, z), type);
+}
+
+void chunk_blocks_pack(DenseChunkBlocks const& dense, ChunkBlocks& blocks);
+void chunk_blocks_unpack(ChunkBlocks const& blocks, DenseChunkBlocks& dense);
+
+// Appends the sections to `out` as they are, packed
+void chunk_blocks_write(ChunkBlocks const& blocks, vector<u8>& out);
+// False when `in` does not hold sections written by chunk_blocks_write, or
+// one of them indexes past its palette
+bool chunk_blocks_read(ByteReader& in, ChunkBlocks& blocks);
+
+// A dense array for the calling thread, to generate or mesh a chunk in
+DenseChunkBlocks& dense_blocks_scratch();
+
+// Memory used by the blocks of chunks, packed and as they would be dense
+struct ChunkBlocksStats {
+  size_t bytes = 0;
+  size_t dense_bytes = 0;
+  u64 air_sections = 0;
+  // sections of one other block type
+  u64 uniform_sections = 0;
+  u64 palette_sections = 0;
+};
+
+size_t chunk_blocks_bytes(ChunkBlocks const& blocks);
+void chunk_blocks_add_stats(ChunkBlocksStats& stats, ChunkBlocks const& blocks);
+
+#endif
@@ -15,9 +15,12 @@
 #include <utility>
 #include <vector>
 
+// HEADLESS builds (the benchmarks) have no window and link no GL libraries
+#ifndef HEADLESS
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#endif
 
 #include <filesystem>
 
@@ -1,14 +1,14 @@
 #ifndef CONSTANTS_HPP
 #define CONSTANTS_HPP
 
-#include <GL/glew.h>
-
 #include "common.hpp"
 #include "image.hpp"
 
+#ifndef HEADLESS
 extern const GLfloat vertices[];
 extern const GLfloat g_color_buffer_data[];
 extern const GLfloat g_uv_buffer_data[];
+#endif
 
 const Color MISSING_COLOR =
     rgba_color(byte(255), byte(0), byte(255), byte(255));
@@ -23,4 +23,13 @@ constexpr int TEXTURE_ROWS = TEXTURE_HEIGHT / TEXTURE_TILE_HEIGHT;
 constexpr int FLOAT_MIN = 0;
 constexpr int FLOAT_MAX = 1;
 
+const int CHUNK_LENGTH = 16;
+const int CHUNK_WIDTH = CHUNK_LENGTH;
+const int CHUNK_HEIGHT = 128;
+// chunks are meshed in vertical sections of this many blocks
+const int CHUNK_SECTION_HEIGHT = 16;
+const int CHUNK_SECTIONS = CHUNK_HEIGHT / CHUNK_SECTION_HEIGHT;
+const int BLOCKS_OF_AIR_ABOVE = 20;
+const int WATER_LEVEL = (int)(CHUNK_HEIGHT * 0.45);
+
 #endif
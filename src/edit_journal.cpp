@@ -0,0 +1,53 @@
+#include "edit_journal.hpp"
+
+void edit_journal_record(EditJournal& journal, ChunkId chunk, BlockEdit edit) {
+  std::lock_guard<std::mutex> guard(journal.mutex);
+  auto& chunk_edits = journal.chunks[chunk];
+  auto [it, inserted] = chunk_edits.by_pos.try_emplace(
+      chunk_edit_key(edit), (u32)chunk_edits.edits.size());
+  journal.edits++;
+  if (inserted) {
+    chunk_edits.edits.push_back(edit);
+  } else {
+    chunk_edits.edits[it->second] = edit;
+    journal.compacted++;
+  }
+}
+
+void edit_journal_restore(EditJournal& journal, ChunkId chunk,
+                          vector<BlockEdit> const& edits) {
+  if (edits.empty()) return;
+  std::lock_guard<std::mutex> guard(journal.mutex);
+  auto& chunk_edits = journal.chunks[chunk];
+  for (auto& edit : edits) {
+    auto [it, inserted] = chunk_edits.by_pos.try_emplace(
+        chunk_edit_key(edit), (u32)chunk_edits.edits.size());
+    if (inserted) chunk_edits.edits.push_back(edit);
+  }
+}
+
+void edit_journal_replay(EditJournal& journal, ChunkId chunk, BlockEdit edit) {
+  std::lock_guard<std::mutex> guard(journal.mutex);
+  auto& chunk_edits = journal.chunks[chunk];
+  auto [it, inserted] = chunk_edits.by_pos.try_emplace(
+      chunk_edit_key(edit), (u32)chunk_edits.edits.size());
+  if (inserted) {
+    chunk_edits.edits.push_back(edit);
+  } else {
+    chunk_edits.edits[it->second] = edit;
+  }
+}
+
+void edit_journal_clear(EditJournal& journal) {
+  std::lock_guard<std::mutex> guard(journal.mutex);
+  journal.chunks.clear();
+}
+
+u64 edit_journal_positions(EditJournal const& journal) {
+  std::lock_guard<std::mutex> guard(journal.mutex);
+  u64 positions = 0;
+  for (auto& [chunk, chunk_edits] : journal.chunks) {
+    positions += chunk_edits.edits.size();
+  }
+  return positions;
+}
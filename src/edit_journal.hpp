@@ -0,0 +1,75 @@
+#ifndef EDIT_JOURNAL_HPP
+#define EDIT_JOURNAL_HPP
+
+#include <atomic>
+#include <mutex>
+
+#include "block.hpp"
+#include "util.hpp"
+
+// A block placed or broken by the player, at a position local to its chunk
+struct BlockEdit {
+  u8 x;
+  u8 y;
+  u8 z;
+  BlockType block;
+};
+static_assert(CHUNK_WIDTH <= 256 && CHUNK_LENGTH <= 256 && CHUNK_HEIGHT <= 256,
+              "BlockEdit positions are stored in bytes");
+
+// The edits of one chunk, the last one of each position only
+struct ChunkEdits {
+  vector<BlockEdit> edits;
+  // index in `edits` of the edit of each position, by chunk_edit_key
+  unordered_map<u32, u32> by_pos;
+};
+
+inline u32 chunk_edit_key(BlockEdit const& edit) {
+  return ((u32)edit.x * CHUNK_LENGTH + edit.y) * CHUNK_HEIGHT + edit.z;
+}
+
+// The player edits by chunk, replayed on top of the generated blocks. A chunk
+// only goes through its own edits, and editing a position again replaces its
+// previous edit, so the journal does not grow with blocks changed back and
+// forth.
+struct EditJournal {
+  unordered_map<ChunkId, ChunkEdits, hash_pair> chunks;
+  mutable std::mutex mutex;
+
+  // statistics
+  std::atomic<u64> edits = 0;
+  // edits that replaced an earlier edit of the same position
+  std::atomic<u64> compacted = 0;
+};
+
+void edit_journal_record(EditJournal& journal, ChunkId chunk, BlockEdit edit);
+// Adds the edits of a chunk read back from disk. The positions edited since
+// are kept as they are.
+void edit_journal_restore(EditJournal& journal, ChunkId chunk,
+                          vector<BlockEdit> const& edits);
+// Adds an edit replayed from the EditLog, replacing the previous edit of the
+// position without counting it in the statistics
+void edit_journal_replay(EditJournal& journal, ChunkId chunk, BlockEdit edit);
+void edit_journal_clear(EditJournal& journal);
+// Number of edited positions
+u64 edit_journal_positions(EditJournal const& journal);
+
+// Calls `f(BlockEdit const&)` for every edit of the chunk
+template <typename F>
+void edit_journal_for_chunk(EditJournal const& journal, ChunkId chunk, F&& f) {
+  std::lock_guard<std::mutex> guard(journal.mutex);
+  auto it = journal.chunks.find(chunk);
+  if (it == journal.chunks.end()) return;
+  for (auto& edit : it->second.edits) f(edit);
+}
+
+// Calls `f(ChunkId, BlockEdit const&)` for every edit of every chunk
+template <typename F>
+void edit_journal_for_each(EditJournal const& journal, F&& f) {
+  std::lock_guard<std::mutex> guard(journal.mutex);
+  for (auto& [chunk, chunk_edits] : journal.chunks) {
+    for (auto& edit : chunk_edits.edits) f(chunk, edit);
+  }
+}
+
+#endif
@@ -0,0 +1,268 @@
+#include "edit_log.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "byte_stream.hpp"
+#include "logger.hpp"
+
+struct EditLogHeader {
+  u32 magic;
+  u32 version;
+};
+
+bool edit_log_write_all(int fd, vector<u8> const& data, u64 at) {
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n =
+        pwrite(fd, data.data() + written, data.size() - written, at + written);
+    if (n <= 0) return false;
+    written += n;
+  }
+  return true;
+}
+
+void edit_log_write_batch(vector<u8>& out,
+                          vector<EditLogRecord> const& records) {
+  size_t size = records.size() * sizeof(EditLogRecord);
+  EditLogBatch batch{
+      .magic = EDIT_LOG_MAGIC,
+      .count = (u32)records.size(),
+      .checksum = (u32)crc32(0, (Bytef const*)records.data(), size),
+  };
+  byte_write(out, batch);
+  byte_write_bytes(out, records.data(), size);
+}
+
+// Writes the journal to a new file and renames it over the log. The edits
+// queued meanwhile are in the journal already, they are dropped from the
+// queue. Returns the edits appended up to the snapshot, or nothing when the
+// log is kept as it was.
+optional<u64> edit_log_compact(EditLog& log) {
+  vector<EditLogRecord> records;
+  vector<EditLogRecord> dropped;
+  u64 appended;
+  {
+    std::lock_guard<std::mutex> guard(log.mutex);
+    dropped.swap(log.queued);
+    appended = log.appended;
+    edit_journal_for_each(*log.journal,
+                          [&](ChunkId chunk, BlockEdit const& edit) {
+                            records.push_back({chunk.first, chunk.second, edit});
+                          });
+  }
+
+  vector<u8> out;
+  byte_write(out, EditLogHeader{EDIT_LOG_MAGIC, EDIT_LOG_VERSION});
+  edit_log_write_batch(out, records);
+  string tmp_path = log.path + ".tmp";
+  int fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  bool ok = fd >= 0 && edit_log_write_all(fd, out, 0) && fsync(fd) == 0 &&
+            rename(tmp_path.c_str(), log.path.c_str()) == 0;
+  if (!ok) {
+    logger::error(fmt::format("Could not compact {}", log.path));
+    if (fd >= 0) close(fd);
+    unlink(tmp_path.c_str());
+    log.write_errors++;
+    log.compact_at = log.records + EDIT_LOG_COMPACT_SLACK;
+    // the dropped edits still have to be written, the others are in the log
+    std::lock_guard<std::mutex> guard(log.mutex);
+    log.queued.insert(log.queued.begin(), dropped.begin(), dropped.end());
+    return {};
+  }
+  // the rename is durable once the directory is synced
+  auto dir = fs::path(log.path).parent_path().string();
+  int dir_fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+  if (dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+
+  close(log.fd);
+  log.fd = fd;
+  log.records = records.size();
+  log.end = out.size();
+  log.compact_at = 2 * log.records + EDIT_LOG_COMPACT_SLACK;
+  log.compactions++;
+  return appended;
+}
+
+void edit_log_run(EditLog& log) {
+  vector<EditLogRecord> batch;
+  vector<u8> out;
+  std::unique_lock<std::mutex> lock(log.mutex);
+  while (true) {
+    log.wake.wait(lock, [&] { return log.stopping || !log.queued.empty(); });
+    // everything queued is written before stopping
+    if (log.queued.empty()) return;
+    std::swap(batch, log.queued);
+    u64 appended = log.appended;
+    lock.unlock();
+
+    out.clear();
+    edit_log_write_batch(out, batch);
+    bool written =
+        edit_log_write_all(log.fd, out, log.end) && fdatasync(log.fd) == 0;
+    if (written) {
+      log.end += out.size();
+      log.records += batch.size();
+      log.batches++;
+      log.records_written += batch.size();
+    } else {
+      logger::error(fmt::format("Could not write to {}", log.path));
+      log.write_errors++;
+      // the replay would stop at what was written of the batch, and drop the
+      // batches written after it
+      if (ftruncate(log.fd, log.end) != 0) log.write_errors++;
+      {
+        std::lock_guard<std::mutex> guard(log.mutex);
+        log.queued.insert(log.queued.begin(), batch.begin(), batch.end());
+      }
+      // the journal has the edits of the batch, the log is written again
+      // from it
+      log.compact_at = log.records;
+    }
+    batch.clear();
+    if (log.records >= log.compact_at) {
+      if (auto compacted = edit_log_compact(log)) {
+        appended = *compacted;
+        written = true;
+      }
+    }
+
+    lock.lock();
+    log.failing = !written;
+    if (written) log.durable = std::max(log.durable, appended);
+    log.synced.notify_all();
+    if (!written) {
+      // the edits left in the queue are lost when stopping
+      if (log.wake.wait_for(lock, EDIT_LOG_RETRY,
+                            [&] { return log.stopping; })) {
+        return;
+      }
+    }
+  }
+}
+
+bool edit_log_open(EditLog& log, string const& path, EditJournal& journal) {
+  edit_log_close(log);
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    logger::error(fmt::format("Could not open {}, the edits are not logged",
+                              path));
+    if (fd >= 0) close(fd);
+    return false;
+  }
+  vector<u8> data(st.st_size);
+  if (pread(fd, data.data(), data.size(), 0) != (ssize_t)data.size()) {
+    data.clear();
+  }
+
+  u64 end = sizeof(EditLogHeader);
+  u64 records = 0;
+  if (data.empty()) {
+    vector<u8> out;
+    byte_write(out, EditLogHeader{EDIT_LOG_MAGIC, EDIT_LOG_VERSION});
+    if (pwrite(fd, out.data(), out.size(), 0) != (ssize_t)out.size()) {
+      logger::error(fmt::format("Could not write to {}", path));
+      close(fd);
+      return false;
+    }
+  } else {
+    ByteReader in{data.data(), data.data() + data.size()};
+    auto header = byte_read<EditLogHeader>(in);
+    if (in.failed || header.magic != EDIT_LOG_MAGIC ||
+        header.version != EDIT_LOG_VERSION) {
+      logger::error(fmt::format("{} is not an edit log, ignored", path));
+      close(fd);
+      return false;
+    }
+    vector<EditLogRecord> batch;
+    while (true) {
+      auto batch_header = byte_read<EditLogBatch>(in);
+      if (in.failed || batch_header.magic != EDIT_LOG_MAGIC ||
+          batch_header.count >
+              (size_t)(in.end - in.at) / sizeof(EditLogRecord)) {
+        break;
+      }
+      size_t size = batch_header.count * sizeof(EditLogRecord);
+      if (crc32(0, in.at, size) != batch_header.checksum) break;
+      batch.resize(batch_header.count);
+      byte_read_bytes(in, batch.data(), size);
+      for (auto& record : batch) {
+        edit_journal_replay(journal, {record.chunk_x, record.chunk_y},
+                            record.edit);
+      }
+      records += batch.size();
+      end = in.at - data.data();
+    }
+    // the batch being written when the game stopped, the next batch is
+    // written over it
+    if (end != data.size()) {
+      logger::info(fmt::format("Dropped the last {} bytes of {}, cut short",
+                               data.size() - end, path));
+      // the next batches would be replayed after what is left of it
+      if (ftruncate(fd, end) != 0) {
+        logger::error(fmt::format(
+            "Could not truncate {}, the edits are not logged", path));
+        log.write_errors++;
+        close(fd);
+        return false;
+      }
+    }
+  }
+  log.path = path;
+  log.fd = fd;
+  log.journal = &journal;
+  log.records = records;
+  log.end = end;
+  log.compact_at =
+      2 * edit_journal_positions(journal) + EDIT_LOG_COMPACT_SLACK;
+  log.records_replayed += records;
+  log.stopping = false;
+  log.writer = std::thread(edit_log_run, std::ref(log));
+  return true;
+}
+
+void edit_log_close(EditLog& log) {
+  if (log.writer.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(log.mutex);
+      log.stopping = true;
+    }
+    log.wake.notify_one();
+    log.writer.join();
+  }
+  if (log.fd >= 0) close(log.fd);
+  log.fd = -1;
+  log.path.clear();
+  log.journal = nullptr;
+  // left by a writer that could not write them
+  log.queued.clear();
+  log.appended = 0;
+  log.durable = 0;
+  log.failing = false;
+}
+
+EditLog::~EditLog() { edit_log_close(*this); }
+
+void edit_log_append(EditLog& log, ChunkId chunk, BlockEdit edit) {
+  if (log.path.empty()) return;
+  {
+    std::lock_guard<std::mutex> guard(log.mutex);
+    log.queued.push_back({chunk.first, chunk.second, edit});
+    log.appended++;
+  }
+  log.wake.notify_one();
+}
+
+bool edit_log_flush(EditLog& log) {
+  std::unique_lock<std::mutex> lock(log.mutex);
+  u64 appended = log.appended;
+  log.synced.wait(lock,
+                  [&] { return log.durable >= appended || log.failing; });
+  return log.durable >= appended;
+}
@@ -0,0 +1,93 @@
+#ifndef EDIT_LOG_HPP
+#define EDIT_LOG_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "edit_journal.hpp"
+
+constexpr u32 EDIT_LOG_MAGIC = 0x474c4445;  // "EDLG"
+constexpr u32 EDIT_LOG_VERSION = 1;
+// the log is compacted once it has this many records more than twice the
+// edits it held after the last compaction
+constexpr u64 EDIT_LOG_COMPACT_SLACK = 1 << 14;
+// how long the writer waits before writing a batch again that it could not
+// write
+constexpr auto EDIT_LOG_RETRY = std::chrono::seconds(1);
+
+// An edit in the log, with the chunk it was made in
+struct EditLogRecord {
+  i32 chunk_x;
+  i32 chunk_y;
+  BlockEdit edit;
+};
+static_assert(sizeof(EditLogRecord) == 12, "EditLogRecord is written as is");
+
+// Written before the records of each batch
+struct EditLogBatch {
+  u32 magic;
+  u32 count;
+  // crc32 of the records
+  u32 checksum;
+};
+
+// The player edits, appended to a file as they are made so they survive a
+// crash. The render thread only queues them; a writer thread appends what
+// was queued since its last write as one checksummed batch and syncs the file
+// once per batch, so edits made while the previous batch was being synced
+// share the next sync. On startup the batches are replayed into the
+// EditJournal up to the first one that is cut short or damaged, which a
+// crash may leave at the end. A batch that could not be written is cut off
+// the file and written again, with the log compacted first.
+//
+// Editing a position again appends a new record, so the log is compacted
+// from time to time: it is written again from the EditJournal, which holds
+// the last edit of each position only, and replaces the log at once.
+struct EditLog {
+  string path;
+  int fd = -1;
+  // compacted from, and replayed into
+  EditJournal* journal = nullptr;
+
+  std::thread writer;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable synced;
+  vector<EditLogRecord> queued;
+  // edits queued so far, and written and synced so far
+  u64 appended = 0;
+  u64 durable = 0;
+  bool stopping = false;
+  // the last batch could not be written
+  bool failing = false;
+
+  // records in the file, where its last whole batch ends, and when to compact
+  // it next; writer thread only
+  u64 records = 0;
+  u64 end = 0;
+  u64 compact_at = EDIT_LOG_COMPACT_SLACK;
+
+  // statistics
+  std::atomic<u64> batches = 0;
+  std::atomic<u64> records_written = 0;
+  std::atomic<u64> records_replayed = 0;
+  std::atomic<u64> compactions = 0;
+  std::atomic<u64> write_errors = 0;
+
+  ~EditLog();
+};
+
+// Replays the log at `path` into the journal, creating it if needed, and
+// starts appending to it
+bool edit_log_open(EditLog& log, string const& path, EditJournal& journal);
+// Writes the queued edits and closes the log
+void edit_log_close(EditLog& log);
+void edit_log_append(EditLog& log, ChunkId chunk, BlockEdit edit);
+// Waits until the edits queued so far are synced to disk, false when the log
+// cannot be written
+bool edit_log_flush(EditLog& log);
+
+#endif
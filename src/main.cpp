@@ -36,6 +36,7 @@
 const int WIDTH = 1920;
 const int HEIGHT = 1080;
 constexpr auto DEFAULT_OUT_DIR = "./temp";
+constexpr auto DEFAULT_SAVE_DIR = "./saves";
 
 struct Entity {
   GLuint vbo;
@@ -79,6 +80,8 @@ struct {
   float last_frame = 0.0f;  // Time of last frame
   int rendering_distance = 8;
   Mode mode = Mode::Playing;
+  // where the chunks are saved, nothing is saved when empty
+  string save_dir;
 
   Texture minimap_tex;
 
@@ -101,13 +104,19 @@ struct {
   vector<ChunkBorderVertex> chunk_borders_mesh;
   GLuint chunk_borders_vao;
 
-  // thread responsible for world gen
-  thread *gen_thread = nullptr;
+  // the indices of the quads of all the chunk meshes, when they are
+  // ChunkQuads::Indexed, and how many quads it has indices for
+  GLuint quad_index_buffer = 0;
+  u32 quad_index_quads = 0;
+
 } state;
 
-inline glm::vec3 get_block_pos_looking_at() {  //
+// The camera looks along (x, height, y), blocks are centred on integer
+// coordinates
+inline WorldPos get_block_pos_looking_at() {  //
   auto player_reach = 3.0f;
-  return state.camera.camera_pos + state.camera.camera_front * player_reach;
+  auto pos = state.camera.camera_pos + state.camera.camera_front * player_reach;
+  return WorldPos{(int)round(pos.x), (int)round(pos.z), (int)round(pos.y)};
 }
 
 void process_left_click() {
@@ -183,7 +192,9 @@ void render_info_bar() {
   ImGui::SameLine();
   ImGui::Text("Avg %.3f ms/frame (%.1f FPS)",
               1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
-  ImGui::Text("Chunks loaded: %lu", state.world.loaded_chunks.size());
+  ImGui::Text("Chunks loaded: %lu, map rebuilt %lu times",
+              chunk_map_size(state.world.loaded_chunks),
+              state.world.loaded_chunks.rebuilds.load());
   ImGui::Text("X=%i, Y=%i, Z=%i", (int)round(state.camera.camera_pos.x),
               (int)round(state.camera.camera_pos.y),
               (int)round(state.camera.camera_pos.z));
@@ -192,10 +203,70 @@ void render_info_bar() {
   ImGui::Text("Total memory usage: %f MB", round(mem_usage_kb / 1024.0F));
   ImGui::Text("Render distance: %i", state.rendering_distance);
   int total_vertices = 0;
+  ChunkBlocksStats blocks;
   for_all_chunks_in_rd(state.world, [&](Chunk &chunk) {
     total_vertices += chunk.mesh_size;  //
+    // skip the chunks a worker is writing the blocks of
+    std::unique_lock<std::mutex> lock(chunk.blocks_mutex, std::try_to_lock);
+    if (lock.owns_lock() && !chunk.is_being_generated) {
+      chunk_blocks_add_stats(blocks, chunk.blocks);
+    }
   });
-  ImGui::Text("Vertices to render: %i", total_vertices);
+  // against one quad per block face, over the meshes built so far
+  auto faces = std::max<u64>(state.world.meshed_faces, 1);
+  auto face_vertices = chunk_quad_vertices(state.world.quads) * faces;
+  ImGui::Text("Vertices to render: %i, %.1f%% fewer than a quad per face",
+              total_vertices,
+              100.0 - 100.0 * state.world.meshed_vertices / face_vertices);
+  auto &slabs = state.world.chunk_slabs;
+  ImGui::Text("Chunks: %lu live, %lu free, peak %lu (%.1f MB)",
+              slabs.live.load(), slabs.free_chunks.load(), slabs.peak.load(),
+              chunk_slab_bytes(slabs) / (1024.0 * 1024.0));
+  ImGui::Text("Block storage: %.1f MB (%.1f MB dense)",
+              blocks.bytes / (1024.0 * 1024.0),
+              blocks.dense_bytes / (1024.0 * 1024.0));
+  ImGui::Text("Sections: %lu air, %lu uniform, %lu palette",
+              blocks.air_sections, blocks.uniform_sections,
+              blocks.palette_sections);
+  if (state.world.chunks_generated > 0) {
+    ImGui::Text("Noise samples per chunk: %lu",
+                state.world.noise_samples / state.world.chunks_generated);
+  }
+  auto &pool = state.world.gen_pool;
+  ImGui::Text("Gen workers: %lu, queued %u, running %u",
+              pool.workers.size(), pool.queued.load(), pool.running.load());
+  ImGui::Text("Gen jobs done %lu, cancelled %lu, stolen %lu",
+              pool.jobs_done.load(), pool.jobs_cancelled.load(),
+              pool.jobs_stolen.load());
+  auto &latency = state.world.chunk_latency;
+  if (latency.count > 0) {
+    ImGui::Text("Chunk ready latency: avg %.1f ms, p50 %.1f ms, p95 %.1f ms",
+                latency.total_ms / latency.count,
+                chunk_latency_percentile(latency, 0.5f),
+                chunk_latency_percentile(latency, 0.95f));
+    ImGui::Text("Chunk ready latency: last %.1f ms, max %.1f ms",
+                latency.last_ms, latency.max_ms);
+  }
+  ImGui::Text("Loading passes: %lu", state.world.scheduler.passes.load());
+  auto &structures = state.world.structures;
+  ImGui::Text("Pending structures: %lu blocks in %lu regions, %.1f KB",
+              structures.mods.load(), structures.regions.load(),
+              structures.bytes.load() / 1024.0);
+  auto &saves = state.world.saves;
+  ImGui::Text("Chunks loaded from disk: %lu, generated %lu",
+              state.world.chunks_loaded.load(),
+              state.world.chunks_generated.load());
+  ImGui::Text("Chunks saved: %lu, %.1f KB (%.1f KB raw), %lu errors",
+              saves.chunks_written.load(), saves.bytes_written / 1024.0,
+              saves.raw_bytes_written / 1024.0, saves.write_errors.load());
+  ImGui::Text("Region files compacted: %lu times, %.1f KB reclaimed",
+              saves.compactions.load(), saves.bytes_reclaimed / 1024.0);
+  auto &edit_log = state.world.edit_log;
+  ImGui::Text("Edit log: %lu edits in %lu syncs, %lu replayed, %lu "
+              "compactions, %lu errors",
+              edit_log.records_written.load(), edit_log.batches.load(),
+              edit_log.records_replayed.load(), edit_log.compactions.load(),
+              edit_log.write_errors.load());
   ImGui::Text("World time: %lu", state.world.time);
   ImGui::Text("Time of day (ticks): %i", state.world.time_of_day);
   int hours = floor((float)state.world.time_of_day / (float)ONE_HOUR);
@@ -220,17 +291,31 @@ void render_info_bar() {
   ImGui::End();
 }
 
-inline u32 chunks_for_rdf(u32 rdf) {
-  return 4 * rdf * rdf;  //
-}
-
 void change_rendering_distance(u32 new_rdf) {
+  std::lock_guard<std::mutex> guard(state.world.load_mutex);
   state.rendering_distance = new_rdf;
-  auto n = chunks_for_rdf(new_rdf);
-  state.world.chunks.resize(n);
-  for (u32 i = 0; i < state.world.chunks.size(); ++i) {
-    state.world.chunks[i] = nullptr;
+  {
+    std::lock_guard<std::mutex> chunks_guard(state.world.chunks_mutex);
+    chunk_grid_resize(state.world.grid, 2 * new_rdf);
   }
+  chunk_scheduler_set_rendering_distance(state.world.scheduler, new_rdf);
+}
+
+void reset_chunks();
+
+// Changes the seed or terrain settings and regenerates the chunks.
+// The chunks of the old settings are saved with them first.
+template <typename F>
+void change_terrain(F &&change) {
+  {
+    // the workers read the noise that init_world replaces
+    std::lock_guard<std::mutex> guard(state.world.load_mutex);
+    chunk_pool_drain(state.world.gen_pool);
+    world_save_chunks(state.world);
+    change();
+    world_open_saves(state.world, state.save_dir);
+  }
+  reset_chunks();
 }
 
 void render_menu() {
@@ -253,6 +338,28 @@ void render_menu() {
   ImGui::Text("Fog gradient");
   ImGui::SliderFloat("fog_gradient", &state.world.fog_gradient, 0.0f, 16.0f);
 
+  // terrain height blending, regenerates the loaded chunks when changed
+  bool lattice = state.world.height_blending == HeightBlending::Lattice;
+  if (ImGui::Checkbox("Lattice height blending", &lattice)) {
+    change_terrain([&] {
+      state.world.height_blending =
+          lattice ? HeightBlending::Lattice : HeightBlending::Exact;
+    });
+  }
+
+  // in the order of ChunkMeshing, meshes the loaded chunks again when changed
+  const char *meshings[] = {"Cubes", "Greedy", "Binary"};
+  int meshing = (int)state.world.meshing;
+  if (ImGui::Combo("Meshing", &meshing, meshings, IM_ARRAYSIZE(meshings))) {
+    // the workers read the meshing while they mesh
+    std::lock_guard<std::mutex> guard(state.world.load_mutex);
+    chunk_pool_drain(state.world.gen_pool);
+    state.world.meshing = (ChunkMeshing)meshing;
+    state.world.meshed_vertices = 0;
+    state.world.meshed_faces = 0;
+    world_remesh_chunks(state.world);
+  }
+
   ImGui::End();
 }
 
@@ -286,8 +393,14 @@ void render_world() {
 
       for_all_chunks_in_rd(state.world, [&](Chunk &chunk) {
         glBindVertexArray(chunk.vao);
+        glUniform3f(block_attrib.chunk_origin, chunk.x, 0.0f, chunk.y);
         // render the chunk mesh
-        glDrawArrays(GL_TRIANGLES, 0, chunk.mesh_size);
+        if (state.world.quads == ChunkQuads::Indexed) {
+          glDrawElements(GL_TRIANGLES, chunk.mesh_size / 4 * 6,
+                         GL_UNSIGNED_INT, nullptr);
+        } else {
+          glDrawArrays(GL_TRIANGLES, 0, chunk.mesh_size);
+        }
         glBindVertexArray(0);
       });
       glUseProgram(0);
@@ -482,6 +595,105 @@ void regenerate_clouds() {
   }
 }
 
+// Makes the shared quad index buffer hold the indices of at least `quads`
+// quads. It is reallocated in place, so the chunk VAOs it is bound to keep
+// it.
+void reserve_quad_indices(u32 quads) {
+  if (quads <= state.quad_index_quads) return;
+  quads = std::max(quads, 2 * state.quad_index_quads);
+  vector<u32> indices(quads * 6);
+  for (u32 quad = 0; quad < quads; ++quad) {
+    for (u32 i = 0; i < 6; ++i) {
+      indices[quad * 6 + i] = quad * 4 + CHUNK_QUAD_INDICES[i];
+    }
+  }
+  if (state.quad_index_buffer == 0) glGenBuffers(1, &state.quad_index_buffer);
+  // bound to no VAO
+  glBindVertexArray(0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state.quad_index_buffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(u32),
+               indices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  state.quad_index_quads = quads;
+}
+
+void set_chunk_vertex_attribs(Chunk &chunk, Attrib const &block_attrib) {
+  if (state.world.quads == ChunkQuads::Indexed) {
+    reserve_quad_indices(chunk.mesh_size / 4);
+  }
+  glBindVertexArray(chunk.vao);
+  glBindBuffer(GL_ARRAY_BUFFER, chunk.buffer);
+  // unpacked by the vertex shader
+  glVertexAttribIPointer(block_attrib.vertex, 2, GL_UNSIGNED_INT,
+                         sizeof(VertexData), (void *)0);
+  glEnableVertexAttribArray(block_attrib.vertex);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  if (state.world.quads == ChunkQuads::Indexed) {
+    // part of the VAO
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state.quad_index_buffer);
+  }
+  glBindVertexArray(0);
+}
+
+// Replaces the vertices of the parts remeshed by an edit or a change of the
+// neighbours in the chunk's buffer, each part on its own. The other parts are
+// left in place, or copied over on the GPU when a part changed size.
+void upload_chunk_mesh_patch(Chunk &chunk, Attrib const &block_attrib) {
+  auto patch = std::move(chunk.mesh_patch);
+  auto &sections = chunk.buffer_sections;
+  auto patched = chunk_mesh_patched_sections(sections, *patch);
+  GLsizeiptr vertex_size = sizeof(VertexData);
+  u32 total = patched[CHUNK_MESH_PARTS];
+  chunk.mesh_size = total;
+
+  if (patched == sections) {
+    // same sizes, overwrite in place
+    glBindBuffer(GL_ARRAY_BUFFER, chunk.buffer);
+    for (u32 part = 0; part < CHUNK_MESH_PARTS; ++part) {
+      auto &mesh = patch->meshes[part];
+      if (!patch->parts[part] || mesh.empty()) continue;
+      glBufferSubData(GL_ARRAY_BUFFER, sections[part] * vertex_size,
+                      mesh.size() * vertex_size, mesh.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  } else {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, total * vertex_size, nullptr,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, chunk.buffer);
+    u32 part = 0;
+    while (part < CHUNK_MESH_PARTS) {
+      if (patch->parts[part]) {
+        auto &mesh = patch->meshes[part];
+        if (!mesh.empty()) {
+          glBufferSubData(GL_COPY_WRITE_BUFFER, patched[part] * vertex_size,
+                          mesh.size() * vertex_size, mesh.data());
+        }
+        part++;
+        continue;
+      }
+      // the parts kept next to each other are copied at once
+      u32 end = part;
+      while (end < CHUNK_MESH_PARTS && !patch->parts[end]) end++;
+      u32 size = sections[end] - sections[part];
+      if (size > 0) {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            sections[part] * vertex_size,
+                            patched[part] * vertex_size, size * vertex_size);
+      }
+      part = end;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &chunk.buffer);
+    chunk.buffer = buffer;
+    set_chunk_vertex_attribs(chunk, block_attrib);
+  }
+  sections = patched;
+}
+
 void update() {
   // delta time
   float current_frame = glfwGetTime();
@@ -493,23 +705,33 @@ void update() {
       glm::ivec3{state.camera.camera_pos.x, state.camera.camera_pos.y,
                  state.camera.camera_pos.z};
 
-  // Only allocate a new buffer if none was allocated before
+  world_update(state.world, state.delta_time);
+  chunk_scheduler_update_player(state.world.scheduler, state.player_pos,
+                                state.camera.camera_front);
+  world_queue_side_remeshes(state.world, state.player_pos,
+                            state.camera.camera_front);
+
   auto shader = shader_storage::get_shader("block");
   for_all_chunks_in_rd(state.world, [&](Chunk &chunk) {
     auto &mesh = chunk.mesh;
 
-    if (!chunk.is_dirty) return;
+    if (!chunk.is_dirty) {
+      // a queued job may still be meshing into the patch
+      if (!chunk.is_queued && chunk.mesh_patch) {
+        upload_chunk_mesh_patch(chunk, shader->attr);
+      }
+      return;
+    }
 
     auto block_attrib = shader->attr;
-    //  if (chunk.vao == 0) {
-    // Configure the VAO
-    glGenVertexArrays(1, &chunk.vao);
-    glGenBuffers(1, &chunk.buffer);
+    // Only allocate a new buffer if none was allocated before
+    if (chunk.vao == 0) {
+      glGenVertexArrays(1, &chunk.vao);
+      glGenBuffers(1, &chunk.buffer);
 #ifdef VAO_ALLOCATION
-    fmt::print("Allocating VAO={}\n", chunk.vao);
+      fmt::print("Allocating VAO={}\n", chunk.vao);
 #endif
-    //  }
-    glBindVertexArray(chunk.vao);
+    }
 
     // Update chunk buffer mesh data
     glBindBuffer(GL_ARRAY_BUFFER, chunk.buffer);
@@ -517,47 +739,25 @@ void update() {
     auto mesh_size = sizeof((*mesh)[0]) * mesh->size();
     auto *meshp = mesh->data();
     chunk.mesh_size = mesh->size();
+    chunk.buffer_sections = chunk.mesh_sections;
     glBufferData(GL_ARRAY_BUFFER, mesh_size, meshp, GL_STATIC_DRAW);
-
-    // Update VAO settings
-    GLsizei stride = sizeof(VertexData);
-    glVertexAttribPointer(block_attrib.position, 3, GL_FLOAT, GL_FALSE, stride,
-                          (void *)offsetof(VertexData, pos));
-    glVertexAttribPointer(block_attrib.normal, 3, GL_FLOAT, GL_FALSE, stride,
-                          (void *)offsetof(VertexData, normal));
-    glVertexAttribPointer(block_attrib.uv, 2, GL_FLOAT, GL_FALSE, stride,
-                          (void *)offsetof(VertexData, uv));
-    // glVertexAttribPointer(block_attrib.ao, 1, GL_FLOAT, GL_FALSE, stride,
-    //                       (void *)offsetof(VertexData, ao));
-    // glVertexAttribPointer(block_attrib.light, 1, GL_FLOAT, GL_FALSE, stride,
-    //                       (void *)offsetof(VertexData, light));
-    glEnableVertexAttribArray(block_attrib.position);
-    glEnableVertexAttribArray(block_attrib.normal);
-    glEnableVertexAttribArray(block_attrib.uv);
-    // glEnableVertexAttribArray(block_attrib.ao);
-    // glEnableVertexAttribArray(block_attrib.light);
-
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    set_chunk_vertex_attribs(chunk, block_attrib);
 
-    glBindVertexArray(0);
-    glDeleteBuffers(1, &chunk.buffer);
-
-    // we've regenerated the chunk mesh
+    // we've regenerated the chunk mesh, it has the edits of the patch
     chunk.is_dirty = false;
+    chunk.mesh_patch.reset();
+    if (chunk.latency_pending) {
+      chunk_latency_record(state.world.chunk_latency, chunk.entered_radius);
+      chunk.latency_pending = false;
+    }
 
     delete mesh;
+    mesh = nullptr;
   });
 
   // Unload unused chunks
-  {
-    std::lock_guard<std::mutex> guard(state.world.chunk_unload_mutex);
-    while (state.world.chunks_to_unload.size() > 0) {
-      auto [key, chunkp] = state.world.chunks_to_unload.back();
-      unload_chunk(chunkp);
-      state.world.loaded_chunks.erase(key);
-      state.world.chunks_to_unload.pop_back();
-    }
-  }
+  free_unloaded_chunks(state.world);
 
   if (state.render_chunk_borders) {
     auto &mesh = state.chunk_borders_mesh;
@@ -621,14 +821,39 @@ void GLAPIENTRY MessageCallback(GLenum source, GLenum type, GLuint id,
 }
 
 void reset_chunks() {
-  for (auto &p : state.world.loaded_chunks) {
+  std::lock_guard<std::mutex> load_guard(state.world.load_mutex);
+  // no job may be left holding a chunk that is freed below
+  chunk_pool_drain(state.world.gen_pool);
+  auto &slabs = state.world.chunk_slabs;
+  {
+    // the chunks waiting to be unloaded are still loaded, freed below
+    std::lock_guard<std::mutex> guard(state.world.chunk_unload_mutex);
+    state.world.chunks_to_unload.clear();
+  }
+  for (auto *chunk : state.world.chunks_to_free) {
+    world_save_chunk(state.world, *chunk);
+    chunk_slab_release(slabs, chunk);
+  }
+  state.world.chunks_to_free.clear();
+  {
+    // keep the size, the next loading pass fills it in place
+    std::lock_guard<std::mutex> chunks_guard(state.world.chunks_mutex);
+    chunk_grid_resize(state.world.grid, state.world.grid.side);
+  }
+  std::lock_guard<std::mutex> loaded_guard(state.world.loaded_chunks_mutex);
+  chunk_map_for_each(state.world.loaded_chunks, [&](ChunkId, Chunk *chunk) {
     // deallocate buffers
-    auto &chunk = p.second;
     unload_chunk(chunk);
-    delete chunk;
-  }
-  state.world.chunks.clear();
-  state.world.loaded_chunks.clear();
+    world_save_chunk(state.world, *chunk);
+    chunk_slab_release(slabs, chunk);
+  });
+  chunk_map_clear(state.world.loaded_chunks);
+  // the workers are drained, nothing else looks chunks up
+  chunk_map_reclaim(state.world.loaded_chunks);
+  chunk_slab_trim(slabs);
+  // the spilled structure blocks depend on the terrain settings
+  structure_store_clear(state.world.structures);
+  chunk_scheduler_notify(state.world.scheduler, ChunkEvent::ChunksReset);
 }
 
 void mouse_button_callback(GLFWwindow *window, int button, int action,
@@ -671,8 +896,7 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action,
     reset_chunks();
   } else if (key == GLFW_KEY_V && action == GLFW_PRESS) {
     Seed seed = random_seed();
-    init_world(state.world, seed);
-    reset_chunks();
+    change_terrain([&] { init_world(state.world, seed); });
   }
 }
 
@@ -726,16 +950,14 @@ void load_shaders() {
       [&](Shader &shader) -> void {
         Attrib block_attrib;
 
-        block_attrib.position = glGetAttribLocation(shader.id, "position");
-        block_attrib.normal = glGetAttribLocation(shader.id, "normal");
-        block_attrib.uv = glGetAttribLocation(shader.id, "texUV");
-        block_attrib.ao = glGetAttribLocation(shader.id, "ao");
-        block_attrib.light = glGetAttribLocation(shader.id, "light");
+        block_attrib.vertex = glGetAttribLocation(shader.id, "vertex");
 
         block_attrib.MVP = glGetUniformLocation(shader.id, "MVP");
         block_attrib.model = glGetUniformLocation(shader.id, "model");
         block_attrib.view = glGetUniformLocation(shader.id, "view");
         block_attrib.projection = glGetUniformLocation(shader.id, "projection");
+        block_attrib.chunk_origin =
+            glGetUniformLocation(shader.id, "chunk_origin");
         block_attrib.sky_color = glGetUniformLocation(shader.id, "sky_color");
         block_attrib.light_pos = glGetUniformLocation(shader.id, "light_pos");
         block_attrib.fog_density =
@@ -872,6 +1094,16 @@ int main(int argc, char **argv) {
        cxxopts::value<string>()->default_value(DEFAULT_OUT_DIR))  //
       ("s,seed", "Worldgen seed",
        cxxopts::value<u64>()->default_value(std::to_string(DEFAULT_SEED)))  //
+      ("b,height-blending", "Biome height blending (exact or lattice)",
+       cxxopts::value<string>()->default_value("exact"))  //
+      ("r,gen-rect", "Worldgen map rectangle: x,y,width,length",
+       cxxopts::value<vector<i32>>()->default_value("0,0,1024,1024"))  //
+      ("save-dir", "Where the world is saved, nothing is saved when empty",
+       cxxopts::value<string>()->default_value(DEFAULT_SAVE_DIR))  //
+      ("meshing", "Chunk meshing (greedy, cubes or binary)",
+       cxxopts::value<string>()->default_value("greedy"))  //
+      ("quads", "How chunk quads are drawn (indexed or triangles)",
+       cxxopts::value<string>()->default_value("indexed"))  //
       ;
 
   init_graphics();
@@ -892,13 +1124,33 @@ int main(int argc, char **argv) {
 
   fmt::print("Using seed {}\n", seed);
   init_world(state.world, seed);
+  if (parsed_opts["height-blending"].as<string>() == "lattice") {
+    state.world.height_blending = HeightBlending::Lattice;
+  }
+  if (parsed_opts["meshing"].as<string>() == "cubes") {
+    state.world.meshing = ChunkMeshing::Cubes;
+  } else if (parsed_opts["meshing"].as<string>() == "binary") {
+    state.world.meshing = ChunkMeshing::Binary;
+  }
+  if (parsed_opts["quads"].as<string>() == "triangles") {
+    state.world.quads = ChunkQuads::Triangles;
+  } else {
+    // grown when a chunk mesh has more quads
+    reserve_quad_indices(CHUNK_WIDTH * CHUNK_LENGTH * CHUNK_SECTION_HEIGHT);
+  }
 
   if (parsed_opts["gen"].as<bool>()) {
     fmt::print("Generating the worldgen maps with seed={}...\n", seed);
     auto out_dir_given = parsed_opts["gen-out"].as<string>();
     auto out_dir = out_dir_given != "" ? out_dir_given : DEFAULT_OUT_DIR;
     auto start = std::chrono::high_resolution_clock::now();
-    world_dump_heights(state.world, out_dir);
+    auto rect = parsed_opts["gen-rect"].as<vector<i32>>();
+    if (rect.size() != 4 || rect[2] <= 0 || rect[3] <= 0) {
+      logger::error("--gen-rect expects x,y,width,length");
+      return 1;
+    }
+    world_dump_heights(state.world, out_dir,
+                       WorldRect{rect[0], rect[1], (u32)rect[2], (u32)rect[3]});
     auto now = std::chrono::high_resolution_clock::now();
     auto milliseconds =
         std::chrono::duration_cast<std::chrono::milliseconds>(now - start);
@@ -907,19 +1159,18 @@ int main(int argc, char **argv) {
     return 0;
   }
 
+  state.save_dir = parsed_opts["save-dir"].as<string>();
+  world_open_saves(state.world, state.save_dir);
+
   glfwShowWindow(state.window);
 
   // initial resize
   change_rendering_distance(state.rendering_distance);
 
   if (state.mode == Mode::Playing) {
-    state.gen_thread = new thread{[&]() -> void {
-      while (!glfwWindowShouldClose(window)) {
-        world_update(state.world, state.delta_time, state.player_pos,
-                     state.rendering_distance);
-        sleep(1);
-      }
-    }};
+    world_start_chunk_loading(state.world, state.player_pos,
+                              state.camera.camera_front,
+                              state.rendering_distance);
   }
 
   while (!glfwWindowShouldClose(window)) {
@@ -933,6 +1184,12 @@ int main(int argc, char **argv) {
   }
 
   // Cleanup
+  chunk_scheduler_stop(state.world.scheduler);
+  chunk_pool_stop(state.world.gen_pool);
+  world_save_chunks(state.world);
+  // waits for the chunks and the edits to be written
+  region_store_close(state.world.saves);
+  edit_log_close(state.world.edit_log);
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();
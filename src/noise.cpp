@@ -0,0 +1,363 @@
+#include "noise.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NOISE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// OpenSimplex 2D constants, see OpenSimplexNoise::Noise
+constexpr double STRETCH_2D = -0.211324865405187;  // (1/sqrt(2+1)-1)/2
+constexpr double SQUISH_2D = 0.366025403784439;    // (sqrt(2+1)-1)/2
+constexpr double NORM_2D = 47.0;
+
+alignas(32) static const double GRADIENTS_2D[16] = {
+    5, 2, 2, 5, -5, 2, -2, 5, 5, -2, 2, -5, -5, -2, -2, -5,
+};
+
+NoiseLattice::NoiseLattice(Seed seed) {
+  i32 source[256];
+  for (i32 i = 0; i < 256; ++i) source[i] = i;
+  // unsigned arithmetic so the LCG wraps without UB
+  u64 s = (u64)seed;
+  const u64 mul = 6364136223846793005ULL;
+  const u64 inc = 1442695040888963407ULL;
+  s = s * mul + inc;
+  s = s * mul + inc;
+  s = s * mul + inc;
+  for (i32 i = 255; i >= 0; --i) {
+    s = s * mul + inc;
+    i32 r = (i32)((i64)(s + 31) % (i + 1));
+    if (r < 0) r += i + 1;
+    this->perm[i] = source[r];
+    source[r] = source[i];
+  }
+}
+
+const char* noise_kernel_name(NoiseKernel kernel) {
+  switch (kernel) {
+    case NoiseKernel::Scalar:
+      return "scalar";
+    case NoiseKernel::AVX2:
+      return "avx2";
+    default:
+      return "auto";
+  }
+}
+
+NoiseKernel noise_detect_kernel() {
+#ifdef NOISE_X86_KERNELS
+  static const NoiseKernel detected = []() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return NoiseKernel::AVX2;
+    return NoiseKernel::Scalar;
+  }();
+  return detected;
+#else
+  return NoiseKernel::Scalar;
+#endif
+}
+
+#ifdef NOISE_X86_KERNELS
+
+// The kernel below is a lane-parallel transcription of
+// OpenSimplexNoise::Noise::eval(double, double). Every branch of the scalar
+// code is evaluated and blended, and contributions with a non-positive
+// attenuation add +0.0, so each lane performs exactly the floating point
+// operations of the scalar code in the same order.
+
+#define NOISE_AVX2 __attribute__((target("avx2")))
+
+// ---------------------------------------------------------------- AVX2 ----
+
+NOISE_AVX2 static inline __m256d extrapolate_avx2(NoiseLattice const& lattice,
+                                                  __m256d xsb, __m256d ysb,
+                                                  __m256d dx, __m256d dy) {
+  const __m128i byte_mask = _mm_set1_epi32(0xFF);
+  // the masked gathers with every lane set load the same as the plain ones,
+  // their zeroed source keeps GCC from warning about an uninitialized one
+  const __m128i all_epi32 = _mm_set1_epi32(-1);
+  const __m256d all_pd = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+  __m128i xi = _mm256_cvtpd_epi32(xsb);
+  __m128i yi = _mm256_cvtpd_epi32(ysb);
+  __m128i p = _mm_mask_i32gather_epi32(_mm_setzero_si128(), lattice.perm,
+                                       _mm_and_si128(xi, byte_mask),
+                                       all_epi32, 4);
+  __m128i index = _mm_mask_i32gather_epi32(
+      _mm_setzero_si128(), lattice.perm,
+      _mm_and_si128(_mm_add_epi32(p, yi), byte_mask), all_epi32, 4);
+  index = _mm_and_si128(index, _mm_set1_epi32(0x0E));
+  __m256d gx = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), GRADIENTS_2D,
+                                        index, all_pd, 8);
+  __m256d gy = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), GRADIENTS_2D + 1,
+                                        index, all_pd, 8);
+  return _mm256_add_pd(_mm256_mul_pd(gx, dx), _mm256_mul_pd(gy, dy));
+}
+
+NOISE_AVX2 static inline __m256d contribute_avx2(NoiseLattice const& lattice,
+                                                 __m256d value, __m256d xsb,
+                                                 __m256d ysb, __m256d dx,
+                                                 __m256d dy) {
+  const __m256d two = _mm256_set1_pd(2.0);
+  __m256d attn = _mm256_sub_pd(_mm256_sub_pd(two, _mm256_mul_pd(dx, dx)),
+                               _mm256_mul_pd(dy, dy));
+  __m256d live = _mm256_cmp_pd(attn, _mm256_setzero_pd(), _CMP_GT_OQ);
+  attn = _mm256_mul_pd(attn, attn);
+  __m256d c = _mm256_mul_pd(_mm256_mul_pd(attn, attn),
+                            extrapolate_avx2(lattice, xsb, ysb, dx, dy));
+  return _mm256_add_pd(value, _mm256_and_pd(live, c));
+}
+
+NOISE_AVX2 static inline __m256d eval_avx2(NoiseLattice const& lattice,
+                                           __m256d x, __m256d y) {
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d two = _mm256_set1_pd(2.0);
+  const __m256d squish = _mm256_set1_pd(SQUISH_2D);
+  const __m256d squish2 = _mm256_set1_pd(2 * SQUISH_2D);
+
+  __m256d stretch = _mm256_mul_pd(_mm256_add_pd(x, y),
+                                  _mm256_set1_pd(STRETCH_2D));
+  __m256d xs = _mm256_add_pd(x, stretch);
+  __m256d ys = _mm256_add_pd(y, stretch);
+  __m256d xsb = _mm256_floor_pd(xs);
+  __m256d ysb = _mm256_floor_pd(ys);
+  __m256d squish_offset = _mm256_mul_pd(_mm256_add_pd(xsb, ysb), squish);
+  __m256d xb = _mm256_add_pd(xsb, squish_offset);
+  __m256d yb = _mm256_add_pd(ysb, squish_offset);
+  __m256d xins = _mm256_sub_pd(xs, xsb);
+  __m256d yins = _mm256_sub_pd(ys, ysb);
+  __m256d in_sum = _mm256_add_pd(xins, yins);
+  __m256d dx0 = _mm256_sub_pd(x, xb);
+  __m256d dy0 = _mm256_sub_pd(y, yb);
+
+  __m256d value = _mm256_setzero_pd();
+
+  // contribution (1,0)
+  __m256d dx1 = _mm256_sub_pd(_mm256_sub_pd(dx0, one), squish);
+  __m256d dy1 = _mm256_sub_pd(dy0, squish);
+  value = contribute_avx2(lattice, value, _mm256_add_pd(xsb, one), ysb, dx1,
+                          dy1);
+
+  // contribution (0,1)
+  __m256d dx2 = _mm256_sub_pd(dx0, squish);
+  __m256d dy2 = _mm256_sub_pd(_mm256_sub_pd(dy0, one), squish);
+  value = contribute_avx2(lattice, value, xsb, _mm256_add_pd(ysb, one), dx2,
+                          dy2);
+
+  __m256d x_gt_y = _mm256_cmp_pd(xins, yins, _CMP_GT_OQ);
+  __m256d dx0_far = _mm256_sub_pd(_mm256_sub_pd(dx0, one), squish2);
+  __m256d dy0_far = _mm256_sub_pd(_mm256_sub_pd(dy0, one), squish2);
+
+  // inside the triangle at (0,0)
+  __m256d zins_a = _mm256_sub_pd(one, in_sum);
+  __m256d near_a =
+      _mm256_or_pd(_mm256_cmp_pd(zins_a, xins, _CMP_GT_OQ),
+                   _mm256_cmp_pd(zins_a, yins, _CMP_GT_OQ));
+  __m256d xsv_a = _mm256_blendv_pd(
+      _mm256_add_pd(xsb, one),
+      _mm256_blendv_pd(_mm256_sub_pd(xsb, one), _mm256_add_pd(xsb, one),
+                       x_gt_y),
+      near_a);
+  __m256d ysv_a = _mm256_blendv_pd(
+      _mm256_add_pd(ysb, one),
+      _mm256_blendv_pd(_mm256_add_pd(ysb, one), _mm256_sub_pd(ysb, one),
+                       x_gt_y),
+      near_a);
+  __m256d dxe_a = _mm256_blendv_pd(
+      dx0_far,
+      _mm256_blendv_pd(_mm256_add_pd(dx0, one), _mm256_sub_pd(dx0, one),
+                       x_gt_y),
+      near_a);
+  __m256d dye_a = _mm256_blendv_pd(
+      dy0_far,
+      _mm256_blendv_pd(_mm256_sub_pd(dy0, one), _mm256_add_pd(dy0, one),
+                       x_gt_y),
+      near_a);
+
+  // inside the triangle at (1,1)
+  __m256d zins_b = _mm256_sub_pd(two, in_sum);
+  __m256d near_b =
+      _mm256_or_pd(_mm256_cmp_pd(zins_b, xins, _CMP_LT_OQ),
+                   _mm256_cmp_pd(zins_b, yins, _CMP_LT_OQ));
+  __m256d xsv_b = _mm256_blendv_pd(
+      xsb,
+      _mm256_blendv_pd(xsb, _mm256_add_pd(xsb, two), x_gt_y), near_b);
+  __m256d ysv_b = _mm256_blendv_pd(
+      ysb,
+      _mm256_blendv_pd(_mm256_add_pd(ysb, two), ysb, x_gt_y), near_b);
+  __m256d dxe_b = _mm256_blendv_pd(
+      dx0,
+      _mm256_blendv_pd(_mm256_sub_pd(dx0, squish2),
+                       _mm256_sub_pd(_mm256_sub_pd(dx0, two), squish2),
+                       x_gt_y),
+      near_b);
+  __m256d dye_b = _mm256_blendv_pd(
+      dy0,
+      _mm256_blendv_pd(_mm256_sub_pd(_mm256_sub_pd(dy0, two), squish2),
+                       _mm256_sub_pd(dy0, squish2), x_gt_y),
+      near_b);
+
+  __m256d lower = _mm256_cmp_pd(in_sum, one, _CMP_LE_OQ);
+  __m256d xsv = _mm256_blendv_pd(xsv_b, xsv_a, lower);
+  __m256d ysv = _mm256_blendv_pd(ysv_b, ysv_a, lower);
+  __m256d dxe = _mm256_blendv_pd(dxe_b, dxe_a, lower);
+  __m256d dye = _mm256_blendv_pd(dye_b, dye_a, lower);
+  __m256d xsb0 = _mm256_blendv_pd(_mm256_add_pd(xsb, one), xsb, lower);
+  __m256d ysb0 = _mm256_blendv_pd(_mm256_add_pd(ysb, one), ysb, lower);
+  dx0 = _mm256_blendv_pd(dx0_far, dx0, lower);
+  dy0 = _mm256_blendv_pd(dy0_far, dy0, lower);
+
+  // contribution (0,0) or (1,1)
+  value = contribute_avx2(lattice, value, xsb0, ysb0, dx0, dy0);
+  // extra vertex
+  value = contribute_avx2(lattice, value, xsv, ysv, dxe, dye);
+
+  return _mm256_div_pd(value, _mm256_set1_pd(NORM_2D));
+}
+
+NOISE_AVX2 void noise_tile_avx2(NoiseLattice const& lattice, float frequency,
+                                float amplitude, u32 octaves, i32 x0, i32 y0,
+                                i32 step, u32 width, u32 length, float* out) {
+  for (u32 ix = 0; ix < width; ++ix) {
+    const float xf = (float)(x0 + (i32)ix * step);
+    for (u32 iy = 0; iy < length; iy += 4) {
+      // the tail is padded by repeating the last column of the tile
+      alignas(16) float yf[4];
+      for (u32 k = 0; k < 4; ++k) {
+        u32 yy = std::min(iy + k, length - 1);
+        yf[k] = (float)(y0 + (i32)yy * step);
+      }
+      __m128 yv = _mm_load_ps(yf);
+      __m128 xv = _mm_set1_ps(xf);
+
+      float amp = amplitude;
+      float amp_sum = 0.0f;
+      __m128 res = _mm_setzero_ps();
+      for (u32 i = 0; i < octaves; ++i) {
+        int kk = 2 << i;
+        __m128 fk = _mm_set1_ps(kk * frequency);
+        amp_sum += amp;
+        __m256d v = eval_avx2(lattice, _mm256_cvtps_pd(_mm_mul_ps(fk, xv)),
+                              _mm256_cvtps_pd(_mm_mul_ps(fk, yv)));
+        // noise() accumulates `res += amp * eval(...)` in double precision
+        __m256d acc = _mm256_add_pd(
+            _mm256_cvtps_pd(res),
+            _mm256_mul_pd(_mm256_set1_pd((double)amp), v));
+        res = _mm256_cvtpd_ps(acc);
+        amp /= 2.0f;
+      }
+      res = _mm_div_ps(res, _mm_set1_ps(amp_sum));
+
+      alignas(16) float lanes[4];
+      _mm_store_ps(lanes, res);
+      u32 n = std::min(4u, length - iy);
+      for (u32 k = 0; k < n; ++k) out[ix * length + iy + k] = lanes[k];
+    }
+  }
+}
+
+#else
+
+// Portable stand-in so the dispatch in noise.hpp links everywhere. It is
+// never selected by noise_detect_kernel() on these targets.
+
+static inline double extrapolate(NoiseLattice const& lattice, i32 xsb, i32 ysb,
+                                 double dx, double dy) {
+  i32 index = lattice.perm[(lattice.perm[xsb & 0xFF] + ysb) & 0xFF] & 0x0E;
+  return GRADIENTS_2D[index] * dx + GRADIENTS_2D[index + 1] * dy;
+}
+
+static inline double contribute(NoiseLattice const& lattice, i32 xsb, i32 ysb,
+                                double dx, double dy) {
+  double attn = 2 - dx * dx - dy * dy;
+  if (attn <= 0) return 0.0;
+  attn *= attn;
+  return attn * attn * extrapolate(lattice, xsb, ysb, dx, dy);
+}
+
+static double lattice_eval(NoiseLattice const& lattice, double x, double y) {
+  double stretch = (x + y) * STRETCH_2D;
+  double xs = x + stretch;
+  double ys = y + stretch;
+  i32 xsb = (i32)floor(xs);
+  i32 ysb = (i32)floor(ys);
+  double squish_offset = (xsb + ysb) * SQUISH_2D;
+  double xins = xs - xsb;
+  double yins = ys - ysb;
+  double in_sum = xins + yins;
+  double dx0 = x - (xsb + squish_offset);
+  double dy0 = y - (ysb + squish_offset);
+  double value = 0;
+  value += contribute(lattice, xsb + 1, ysb, dx0 - 1 - SQUISH_2D,
+                      dy0 - SQUISH_2D);
+  value += contribute(lattice, xsb, ysb + 1, dx0 - SQUISH_2D,
+                      dy0 - 1 - SQUISH_2D);
+  i32 xsv, ysv;
+  double dxe, dye;
+  if (in_sum <= 1) {
+    double zins = 1 - in_sum;
+    if (zins > xins || zins > yins) {
+      if (xins > yins) {
+        xsv = xsb + 1, ysv = ysb - 1, dxe = dx0 - 1, dye = dy0 + 1;
+      } else {
+        xsv = xsb - 1, ysv = ysb + 1, dxe = dx0 + 1, dye = dy0 - 1;
+      }
+    } else {
+      xsv = xsb + 1, ysv = ysb + 1;
+      dxe = dx0 - 1 - 2 * SQUISH_2D, dye = dy0 - 1 - 2 * SQUISH_2D;
+    }
+  } else {
+    double zins = 2 - in_sum;
+    if (zins < xins || zins < yins) {
+      if (xins > yins) {
+        xsv = xsb + 2, ysv = ysb;
+        dxe = dx0 - 2 - 2 * SQUISH_2D, dye = dy0 - 2 * SQUISH_2D;
+      } else {
+        xsv = xsb, ysv = ysb + 2;
+        dxe = dx0 - 2 * SQUISH_2D, dye = dy0 - 2 - 2 * SQUISH_2D;
+      }
+    } else {
+      xsv = xsb, ysv = ysb, dxe = dx0, dye = dy0;
+    }
+    xsb += 1;
+    ysb += 1;
+    dx0 = dx0 - 1 - 2 * SQUISH_2D;
+    dy0 = dy0 - 1 - 2 * SQUISH_2D;
+  }
+  value += contribute(lattice, xsb, ysb, dx0, dy0);
+  value += contribute(lattice, xsv, ysv, dxe, dye);
+  return value / NORM_2D;
+}
+
+static void noise_tile_portable(NoiseLattice const& lattice, float frequency,
+                                float amplitude, u32 octaves, i32 x0, i32 y0,
+                                i32 step, u32 width, u32 length, float* out) {
+  for (u32 ix = 0; ix < width; ++ix) {
+    for (u32 iy = 0; iy < length; ++iy) {
+      float x = (float)(x0 + (i32)ix * step);
+      float y = (float)(y0 + (i32)iy * step);
+      float amp = amplitude;
+      float res = 0.0f;
+      float amp_sum = 0.0f;
+      for (u32 i = 0; i < octaves; ++i) {
+        int kk = 2 << i;
+        amp_sum += amp;
+        res += amp * lattice_eval(lattice, kk * frequency * x,
+                                  kk * frequency * y);
+        amp /= 2.0f;
+      }
+      out[ix * length + iy] = res / amp_sum;
+    }
+  }
+}
+
+void noise_tile_avx2(NoiseLattice const& lattice, float frequency,
+                     float amplitude, u32 octaves, i32 x0, i32 y0, i32 step,
+                     u32 width, u32 length, float* out) {
+  noise_tile_portable(lattice, frequency, amplitude, octaves, x0, y0, step,
+                      width, length, out);
+}
+
+#endif
@@ -6,8 +6,43 @@
 
 using Seed = i64;
 
+// Number of fractal noise samples (one per point and noise field, whatever
+// the octave count) taken on the current thread. Worldgen reads the delta
+// around a chunk to report its noise cost.
+inline thread_local u64 noise_sample_count = 0;
+
+// Which implementation fills noise tiles. `Auto` picks the widest kernel the
+// CPU supports at runtime. There is no SSE4.1 kernel: without gathers its two
+// double lanes look the gradients up one by one, which made it slower than
+// the scalar path.
+enum class NoiseKernel {
+  Scalar,
+  AVX2,
+  Auto,
+};
+
+// Permutation table of the OpenSimplex lattice. This is the same table
+// OpenSimplexNoise::Noise derives from the seed (the 64-bit LCG shuffle),
+// duplicated here because the library keeps its own copy private and the
+// vector kernels need to gather from it.
+struct NoiseLattice {
+  i32 perm[256];
+
+  explicit NoiseLattice(Seed seed);
+};
+
+NoiseKernel noise_detect_kernel();
+const char* noise_kernel_name(NoiseKernel kernel);
+
+// Fractal noise over a tile with the vector kernel. The output layout and the
+// arithmetic are described at OpenSimplexNoiseWParam::noise_tile.
+void noise_tile_avx2(NoiseLattice const& lattice, float frequency,
+                     float amplitude, u32 octaves, i32 x0, i32 y0, i32 step,
+                     u32 width, u32 length, float* out);
+
 struct OpenSimplexNoiseWParam {
   unique_ptr<OpenSimplexNoise::Noise> osn = nullptr;
+  unique_ptr<NoiseLattice> lattice = nullptr;
   Seed seed = 0;
   float frequency = 0.0f;
   float amplitude = 0.0f;
@@ -18,15 +53,22 @@ struct OpenSimplexNoiseWParam {
                          Seed _seed)
       : osn(make_unique<OpenSimplexNoise::Noise>(
             OpenSimplexNoise::Noise(_seed))),
+        lattice(make_unique<NoiseLattice>(_seed)),
         seed(_seed),
         frequency(_frequency),
         amplitude(_amplitude) {}
 
-  inline float noise(u32 octaves, int x, int y) {
+  inline float noise(u32 octaves, int x, int y) const {
     return this->noise(octaves, (float)x, (float)y);
   }
 
-  float noise(u32 octaves, float x, float y) {
+  float noise(u32 octaves, float x, float y) const {
+    ++noise_sample_count;
+    return this->fractal(octaves, x, y);
+  }
+
+  // noise() without bumping noise_sample_count
+  float fractal(u32 octaves, float x, float y) const {
     float amp = this->amplitude;
     float res = 0.0f;
     float amp_sum = 0.0f;
@@ -40,6 +82,40 @@ struct OpenSimplexNoiseWParam {
     res /= amp_sum;
     return res;
   }
+
+  // Fills a width x length tile of fractal noise in one call:
+  //
+  //   out[ix * length + iy] = noise(octaves, x0 + ix * step, y0 + iy * step)
+  //
+  // i.e. the same [x][y] layout as Chunk::blocks. The vector kernels evaluate
+  // the lattice in double precision and repeat the float rounding steps of
+  // noise(), so on x86-64 their output is bit-identical to the scalar path.
+  // The documented tolerance is |tile - noise()| <= 1e-6, which leaves room
+  // for compilers that contract the octave sum into FMA instructions.
+  void noise_tile(u32 octaves, i32 x0, i32 y0, u32 width, u32 length,
+                  float* out, i32 step = 1,
+                  NoiseKernel kernel = NoiseKernel::Auto) const {
+    noise_sample_count += (u64)width * length;
+    if (kernel == NoiseKernel::Auto) kernel = noise_detect_kernel();
+    switch (kernel) {
+      case NoiseKernel::AVX2: {
+        noise_tile_avx2(*this->lattice, this->frequency, this->amplitude,
+                        octaves, x0, y0, step, width, length, out);
+      } break;
+      default: {
+        for (u32 ix = 0; ix < width; ++ix) {
+          for (u32 iy = 0; iy < length; ++iy) {
+            out[ix * length + iy] =
+                this->fractal(octaves, (float)(x0 + (i32)ix * step),
+                              (float)(y0 + (i32)iy * step));
+          }
+        }
+      } break;
+    }
+  }
 };
 
+// Largest deviation between noise_tile and noise() that callers may rely on
+constexpr float NOISE_TILE_TOLERANCE = 1e-6f;
+
 #endif
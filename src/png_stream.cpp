@@ -0,0 +1,119 @@
+#include "png_stream.hpp"
+
+#include <zlib.h>
+
+#include <cstring>
+
+#include "logger.hpp"
+
+static const u8 PNG_SIGNATURE[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+inline void put_u32_be(u8* out, u32 v) {
+  out[0] = (u8)(v >> 24);
+  out[1] = (u8)(v >> 16);
+  out[2] = (u8)(v >> 8);
+  out[3] = (u8)v;
+}
+
+void png_write_chunk(PngStream& png, const char type[4], u8 const* data,
+                     u32 size) {
+  u8 header[8];
+  put_u32_be(header, size);
+  memcpy(header + 4, type, 4);
+  u32 crc = crc32(0, header + 4, 4);
+  if (size != 0) crc = crc32(crc, data, size);
+  u8 footer[4];
+  put_u32_be(footer, crc);
+  bool ok = fwrite(header, 1, 8, png.file) == 8;
+  if (size != 0) ok = ok && fwrite(data, 1, size, png.file) == size;
+  ok = ok && fwrite(footer, 1, 4, png.file) == 4;
+  if (!ok) png.failed = true;
+}
+
+// Deflates the input of the z stream, writing an IDAT for every full buffer
+void png_deflate(PngStream& png, int flush) {
+  auto* zs = png.zs;
+  int ret;
+  do {
+    zs->next_out = png.deflated.data();
+    zs->avail_out = png.deflated.size();
+    ret = deflate(zs, flush);
+    u32 have = png.deflated.size() - zs->avail_out;
+    if (have != 0) png_write_chunk(png, "IDAT", png.deflated.data(), have);
+  } while (zs->avail_out == 0 && ret != Z_STREAM_END);
+}
+
+bool png_stream_open(PngStream& png, string const& path, u32 width,
+                     u32 height) {
+  png.file = fopen(path.c_str(), "wb");
+  if (png.file == nullptr) {
+    logger::error(fmt::format("Failed to open \"{}\" for writing", path));
+    return false;
+  }
+  png.width = width;
+  png.height = height;
+  png.rows_written = 0;
+  png.failed = false;
+  png.row.resize(1 + (size_t)width * 4);
+  png.deflated.resize(PNG_STREAM_CHUNK_SIZE);
+  png.zs = new z_stream{};
+  if (deflateInit(png.zs, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    logger::error("Failed to initialize deflate");
+    png.failed = true;
+  }
+
+  fwrite(PNG_SIGNATURE, 1, sizeof(PNG_SIGNATURE), png.file);
+  u8 ihdr[13];
+  put_u32_be(ihdr, width);
+  put_u32_be(ihdr + 4, height);
+  ihdr[8] = 8;   // bit depth
+  ihdr[9] = 6;   // RGBA
+  ihdr[10] = 0;  // deflate
+  ihdr[11] = 0;  // adaptive filtering
+  ihdr[12] = 0;  // not interlaced
+  png_write_chunk(png, "IHDR", ihdr, sizeof(ihdr));
+  return !png.failed;
+}
+
+void png_stream_write_rows(PngStream& png, Pixel const* pixels, u32 nrows) {
+  if (png.failed) return;
+  for (u32 r = 0; r < nrows; ++r) {
+    // filter type Sub: the map colors change little along a row
+    auto* src = (u8 const*)(pixels + (size_t)r * png.width);
+    auto* dst = png.row.data();
+    dst[0] = 1;
+    memcpy(dst + 1, src, 4);
+    for (size_t i = 4; i < (size_t)png.width * 4; ++i) {
+      dst[1 + i] = (u8)(src[i] - src[i - 4]);
+    }
+    png.zs->next_in = dst;
+    png.zs->avail_in = png.row.size();
+    png_deflate(png, Z_NO_FLUSH);
+  }
+  png.rows_written += nrows;
+}
+
+bool png_stream_close(PngStream& png) {
+  if (png.file == nullptr) return false;
+  if (png.rows_written != png.height) {
+    logger::error(fmt::format("PNG got {} rows, expected {}", png.rows_written,
+                              png.height));
+    png.failed = true;
+  }
+  if (png.zs != nullptr) {
+    if (!png.failed) {
+      png.zs->next_in = nullptr;
+      png.zs->avail_in = 0;
+      png_deflate(png, Z_FINISH);
+    }
+    deflateEnd(png.zs);
+    delete png.zs;
+    png.zs = nullptr;
+  }
+  png_write_chunk(png, "IEND", nullptr, 0);
+  if (fclose(png.file) != 0) png.failed = true;
+  png.file = nullptr;
+  png.row = {};
+  png.deflated = {};
+  return !png.failed;
+}
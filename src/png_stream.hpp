@@ -0,0 +1,35 @@
+#ifndef PNG_STREAM_HPP
+#define PNG_STREAM_HPP
+
+#include <cstdio>
+
+#include "common.hpp"
+#include "image.hpp"
+
+struct z_stream_s;
+
+// Writes an RGBA PNG a band of rows at a time, so the image never has to be
+// in memory as a whole. The rows are deflated as they come and written out
+// in IDAT chunks of PNG_STREAM_CHUNK_SIZE bytes.
+struct PngStream {
+  FILE* file = nullptr;
+  z_stream_s* zs = nullptr;
+  u32 width = 0;
+  u32 height = 0;
+  u32 rows_written = 0;
+  // a filter byte followed by the pixels of one row
+  vector<u8> row;
+  vector<u8> deflated;
+  bool failed = false;
+};
+
+constexpr u32 PNG_STREAM_CHUNK_SIZE = 256 * 1024;
+
+bool png_stream_open(PngStream& png, string const& path, u32 width,
+                     u32 height);
+// Appends `nrows` rows of `png.width` pixels each
+void png_stream_write_rows(PngStream& png, Pixel const* pixels, u32 nrows);
+// Finishes the image, false if anything failed to be written
+bool png_stream_close(PngStream& png);
+
+#endif
@@ -0,0 +1,296 @@
+#include "region_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <cstddef>
+
+#include "logger.hpp"
+
+string region_file_path(RegionStore const& store, RegionFileId id) {
+  return fmt::format("{}/r.{}.{}.bin", store.dir, id.first, id.second);
+}
+
+void region_file_close(RegionFile& file) {
+  if (file.map != nullptr) munmap(file.map, file.map_size);
+  if (file.fd >= 0) close(file.fd);
+  file.map = nullptr;
+  file.map_size = 0;
+  file.fd = -1;
+}
+
+// Maps the file up to its current end, with the file's mutex held alone
+void region_file_map(RegionFile& file) {
+  struct stat st;
+  if (fstat(file.fd, &st) != 0 || (size_t)st.st_size <= file.map_size) return;
+  if (file.map != nullptr) munmap(file.map, file.map_size);
+  file.map = nullptr;
+  file.map_size = 0;
+  void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, file.fd, 0);
+  if (map == MAP_FAILED) return;
+  file.map = (u8*)map;
+  file.map_size = st.st_size;
+}
+
+// nullptr when the file does not exist, or is not a region file
+unique_ptr<RegionFile> region_file_open(string const& path, bool create) {
+  int fd = open(path.c_str(), create ? O_RDWR | O_CREAT : O_RDWR, 0644);
+  if (fd < 0) {
+    if (create) logger::error(fmt::format("Could not create {}", path));
+    return nullptr;
+  }
+  auto header = make_unique<RegionFileHeader>();
+  ssize_t n = pread(fd, header.get(), sizeof(RegionFileHeader), 0);
+  if (n == 0 && create) {
+    header->magic = REGION_FILE_MAGIC;
+    header->version = REGION_FILE_VERSION;
+    n = pwrite(fd, header.get(), sizeof(RegionFileHeader), 0);
+  }
+  if (n != sizeof(RegionFileHeader) || header->magic != REGION_FILE_MAGIC ||
+      header->version != REGION_FILE_VERSION) {
+    // an empty file, left by a crash right after it was created, is started
+    // over by the writer
+    if (n > 0 || create) {
+      logger::error(fmt::format("{} is not a region file, ignored", path));
+    }
+    close(fd);
+    return nullptr;
+  }
+  auto file = make_unique<RegionFile>();
+  file->fd = fd;
+  file->slots = header->slots;
+  for (auto& slot : file->slots) file->live += slot.size;
+  struct stat st;
+  file->end = fstat(fd, &st) == 0 ? st.st_size : sizeof(RegionFileHeader);
+  return file;
+}
+
+// Copies the live payloads of the file into a new one next to it, which then
+// replaces it. The file is left as it was when that fails. Writer thread only.
+bool region_file_compact(RegionStore& store, RegionFile& file,
+                         string const& path) {
+  string tmp_path = path + ".tmp";
+  int fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+  auto header = make_unique<RegionFileHeader>();
+  header->magic = REGION_FILE_MAGIC;
+  header->version = REGION_FILE_VERSION;
+  header->slots = file.slots;
+  u64 end = sizeof(RegionFileHeader);
+  vector<u8> payload;
+  bool ok = true;
+  for (auto& slot : header->slots) {
+    if (slot.size == 0) continue;
+    payload.resize(slot.size);
+    ok = pread(file.fd, payload.data(), slot.size, slot.offset) ==
+             (ssize_t)slot.size &&
+         pwrite(fd, payload.data(), slot.size, end) == (ssize_t)slot.size;
+    if (!ok) break;
+    slot.offset = (u32)end;
+    end += slot.size;
+  }
+  // the new file is complete on disk before it replaces the old one
+  ok = ok &&
+       pwrite(fd, header.get(), sizeof(RegionFileHeader), 0) ==
+           sizeof(RegionFileHeader) &&
+       fdatasync(fd) == 0 && rename(tmp_path.c_str(), path.c_str()) == 0;
+  if (!ok) {
+    logger::error(fmt::format("Could not compact {}", path));
+    close(fd);
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  store.compactions++;
+  store.bytes_reclaimed += file.end - end;
+  std::unique_lock<std::shared_mutex> lock(file.mutex);
+  // mapped again by the next read
+  region_file_close(file);
+  file.fd = fd;
+  file.slots = header->slots;
+  file.end = end;
+  return true;
+}
+
+RegionFile* region_store_file(RegionStore& store, RegionFileId id,
+                              bool create) {
+  std::lock_guard<std::mutex> guard(store.files_mutex);
+  auto [it, inserted] = store.files.try_emplace(id);
+  if (inserted || (create && it->second == nullptr)) {
+    it->second = region_file_open(region_file_path(store, id), create);
+  }
+  return it->second.get();
+}
+
+// Deflates the payload and appends it to the region file, then points the
+// chunk's slot at it. The file is compacted first when it holds too many
+// payloads that were saved again since, or the new one would not fit.
+void region_store_write_chunk(RegionStore& store, ChunkId id,
+                              vector<u8> const& data, vector<u8>& deflated) {
+  auto file_id = region_file_of(id);
+  auto* file = region_store_file(store, file_id, true);
+  if (file == nullptr) {
+    store.write_errors++;
+    return;
+  }
+  uLongf size = compressBound(data.size());
+  deflated.resize(size);
+  // the fastest level, the writer has to keep up with the player
+  if (compress2(deflated.data(), &size, data.data(), data.size(),
+                Z_BEST_SPEED) != Z_OK) {
+    store.write_errors++;
+    return;
+  }
+  u64 dead = file->end - sizeof(RegionFileHeader) - file->live;
+  if ((dead > file->live && dead >= REGION_FILE_COMPACT_BYTES) ||
+      file->end + size > UINT32_MAX) {
+    region_file_compact(store, *file, region_file_path(store, file_id));
+  }
+  if (file->end + size > UINT32_MAX) {
+    store.write_errors++;
+    return;
+  }
+  RegionSlot slot{
+      .offset = (u32)file->end,
+      .size = (u32)size,
+      .raw_size = (u32)data.size(),
+      .checksum = (u32)crc32(0, deflated.data(), size),
+  };
+  if (pwrite(file->fd, deflated.data(), size, file->end) != (ssize_t)size) {
+    store.write_errors++;
+    return;
+  }
+  file->end += size;
+  u32 index = region_file_slot(id);
+  file->live += size - file->slots[index].size;
+  {
+    std::unique_lock<std::shared_mutex> lock(file->mutex);
+    file->slots[index] = slot;
+  }
+  // the payload is in the file before the slot points at it
+  off_t at = offsetof(RegionFileHeader, slots) + index * sizeof(RegionSlot);
+  if (pwrite(file->fd, &slot, sizeof(slot), at) != sizeof(slot)) {
+    store.write_errors++;
+    return;
+  }
+  store.chunks_written++;
+  store.bytes_written += size;
+  store.raw_bytes_written += data.size();
+}
+
+void region_store_run(RegionStore& store) {
+  vector<u8> deflated;
+  std::unique_lock<std::mutex> lock(store.queue_mutex);
+  while (true) {
+    store.wake.wait(lock,
+                    [&] { return store.stopping || !store.queued.empty(); });
+    // everything queued is written before stopping
+    if (store.queued.empty()) return;
+    std::swap(store.queued, store.writing);
+    lock.unlock();
+    for (auto& [id, data] : store.writing) {
+      region_store_write_chunk(store, id, data, deflated);
+    }
+    lock.lock();
+    store.writing.clear();
+    store.written.notify_all();
+  }
+}
+
+void region_store_open(RegionStore& store, string const& dir) {
+  if (dir == store.dir) return;
+  region_store_close(store);
+  if (dir.empty()) return;
+  std::error_code error;
+  fs::create_directories(dir, error);
+  if (error) {
+    logger::error(fmt::format("Could not create {}: {}, the world is not saved",
+                              dir, error.message()));
+    return;
+  }
+  store.dir = dir;
+  store.stopping = false;
+  store.writer = std::thread(region_store_run, std::ref(store));
+}
+
+void region_store_close(RegionStore& store) {
+  if (store.writer.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(store.queue_mutex);
+      store.stopping = true;
+    }
+    store.wake.notify_one();
+    store.writer.join();
+  }
+  std::lock_guard<std::mutex> guard(store.files_mutex);
+  for (auto& [id, file] : store.files) {
+    if (file != nullptr) region_file_close(*file);
+  }
+  store.files.clear();
+  store.dir.clear();
+}
+
+RegionStore::~RegionStore() { region_store_close(*this); }
+
+void region_store_write(RegionStore& store, ChunkId id, vector<u8> data) {
+  if (store.dir.empty()) return;
+  {
+    std::lock_guard<std::mutex> guard(store.queue_mutex);
+    store.queued[id] = std::move(data);
+  }
+  store.wake.notify_one();
+}
+
+bool region_store_read(RegionStore& store, ChunkId id, vector<u8>& data) {
+  if (store.dir.empty()) return false;
+  {
+    // the queued payload is newer than the one being written
+    std::lock_guard<std::mutex> guard(store.queue_mutex);
+    for (auto* queue : {&store.queued, &store.writing}) {
+      auto it = queue->find(id);
+      if (it == queue->end()) continue;
+      data = it->second;
+      store.chunks_read++;
+      return true;
+    }
+  }
+
+  auto* file = region_store_file(store, region_file_of(id), false);
+  if (file == nullptr) return false;
+  u32 index = region_file_slot(id);
+  std::shared_lock<std::shared_mutex> lock(file->mutex);
+  auto slot = file->slots[index];
+  if (slot.size == 0) return false;
+  if ((u64)slot.offset + slot.size > file->map_size) {
+    lock.unlock();
+    {
+      std::unique_lock<std::shared_mutex> map_lock(file->mutex);
+      if ((u64)slot.offset + slot.size > file->map_size) {
+        region_file_map(*file);
+      }
+    }
+    lock.lock();
+    if ((u64)slot.offset + slot.size > file->map_size) return false;
+  }
+
+  u8 const* payload = file->map + slot.offset;
+  uLongf size = slot.raw_size;
+  data.resize(slot.raw_size);
+  if (crc32(0, payload, slot.size) != slot.checksum ||
+      uncompress(data.data(), &size, payload, slot.size) != Z_OK ||
+      size != slot.raw_size) {
+    logger::error(fmt::format("The saved chunk at {}, {} is damaged, ignored",
+                              id.first, id.second));
+    return false;
+  }
+  store.chunks_read++;
+  return true;
+}
+
+void region_store_flush(RegionStore& store) {
+  std::unique_lock<std::mutex> lock(store.queue_mutex);
+  store.written.wait(
+      lock, [&] { return store.queued.empty() && store.writing.empty(); });
+}
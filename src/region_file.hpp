@@ -0,0 +1,131 @@
+#ifndef REGION_FILE_HPP
+#define REGION_FILE_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#include "constants.hpp"
+#include "util.hpp"
+
+// side of a region file, in chunks
+constexpr i32 REGION_FILE_CHUNKS = 32;
+constexpr u32 REGION_FILE_SLOTS = REGION_FILE_CHUNKS * REGION_FILE_CHUNKS;
+constexpr u32 REGION_FILE_MAGIC = 0x4e474552;  // "REGN"
+constexpr u32 REGION_FILE_VERSION = 1;
+
+// Where the payload of a chunk is in its region file. `size` is 0 when the
+// chunk was never saved.
+struct RegionSlot {
+  u32 offset;
+  // deflated size
+  u32 size;
+  u32 raw_size;
+  // crc32 of the deflated payload
+  u32 checksum;
+};
+
+// The file starts with this header, followed by the chunk payloads in the
+// order they were written
+struct RegionFileHeader {
+  u32 magic;
+  u32 version;
+  std::array<RegionSlot, REGION_FILE_SLOTS> slots;
+};
+
+// (x, y) of the region, in regions
+using RegionFileId = pair<i32, i32>;
+
+// A region file is compacted once the payloads left behind take more room
+// than the live ones, and at least this much
+constexpr u64 REGION_FILE_COMPACT_BYTES = 1 << 20;
+
+// One open region file. The payloads are only ever appended: a chunk saved
+// again gets a new slot at the end of the file and the old payload is left
+// behind, so the readers never see one being overwritten. The live payloads
+// are copied into a new file once there are too many old ones, which then
+// replaces the file.
+struct RegionFile {
+  int fd = -1;
+  // the file mapped for reading, remapped once it grew past the mapping
+  u8* map = nullptr;
+  size_t map_size = 0;
+  std::array<RegionSlot, REGION_FILE_SLOTS> slots{};
+  // where the next payload goes, and the size of the payloads the slots
+  // point at; writer thread only
+  u64 end = 0;
+  u64 live = 0;
+  // shared by the readers, held alone to remap, to update `slots` and to
+  // switch to the compacted file
+  std::shared_mutex mutex;
+};
+
+// Chunks saved in region files of REGION_FILE_CHUNKS x REGION_FILE_CHUNKS
+// chunks. The payloads are deflated and appended by a writer thread, so
+// saving a chunk only copies its payload into a queue; the chunks are read
+// back through a mapping of their file.
+struct RegionStore {
+  // directory of the region files, nothing is read or written when empty
+  string dir;
+
+  std::mutex files_mutex;
+  // the files opened so far, nullptr for the ones that do not exist or could
+  // not be used
+  unordered_map<RegionFileId, unique_ptr<RegionFile>, hash_pair> files;
+
+  std::thread writer;
+  std::mutex queue_mutex;
+  std::condition_variable wake;
+  std::condition_variable written;
+  // the latest payload of the chunks waiting to be written, and of the ones
+  // being written. They are read from here until they are in their file.
+  unordered_map<ChunkId, vector<u8>, hash_pair> queued;
+  unordered_map<ChunkId, vector<u8>, hash_pair> writing;
+  bool stopping = false;
+
+  // statistics
+  std::atomic<u64> chunks_read = 0;
+  std::atomic<u64> chunks_written = 0;
+  std::atomic<u64> bytes_written = 0;
+  std::atomic<u64> raw_bytes_written = 0;
+  std::atomic<u64> write_errors = 0;
+  std::atomic<u64> compactions = 0;
+  std::atomic<u64> bytes_reclaimed = 0;
+
+  ~RegionStore();
+};
+
+inline RegionFileId region_file_of(ChunkId id) {
+  constexpr i32 w = REGION_FILE_CHUNKS * CHUNK_WIDTH;
+  constexpr i32 l = REGION_FILE_CHUNKS * CHUNK_LENGTH;
+  // rounded towards negative infinity
+  i32 x = id.first >= 0 ? id.first / w : (id.first - w + 1) / w;
+  i32 y = id.second >= 0 ? id.second / l : (id.second - l + 1) / l;
+  return {x, y};
+}
+
+// Slot of the chunk in its region file
+inline u32 region_file_slot(ChunkId id) {
+  u32 x = (u32)(id.first / CHUNK_WIDTH) % REGION_FILE_CHUNKS;
+  u32 y = (u32)(id.second / CHUNK_LENGTH) % REGION_FILE_CHUNKS;
+  return y * REGION_FILE_CHUNKS + x;
+}
+
+// Writes the queued chunks and switches to the region files in `dir`,
+// created if needed. An empty `dir` stops saving chunks.
+void region_store_open(RegionStore& store, string const& dir);
+// Writes the queued chunks, closes the files and stops the writer
+void region_store_close(RegionStore& store);
+// Queues the payload of the chunk to be written, replacing the one queued
+// before
+void region_store_write(RegionStore& store, ChunkId id, vector<u8> data);
+// The payload of the chunk, false when it was never saved or its file is
+// damaged. Safe to call from any number of threads.
+bool region_store_read(RegionStore& store, ChunkId id, vector<u8>& data);
+// Waits until the queued chunks are in their files
+void region_store_flush(RegionStore& store);
+
+#endif
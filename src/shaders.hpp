@@ -4,18 +4,18 @@
 #include "common.hpp"
 
 struct Attrib {
+  // sky, cloud and line vertices
   GLint position;
-  GLint normal;
   GLint uv;
-  GLint ao;
-  GLint light;
-
   GLint color;
+  // packed chunk mesh vertex
+  GLint vertex;
 
   GLint MVP;
   GLint model;
   GLint view;
   GLint projection;
+  GLint chunk_origin;
 
   GLint light_pos;
 
@@ -0,0 +1,123 @@
+#include "structure_store.hpp"
+
+// heap bytes of a std::map or std::unordered_map node beside its value (links,
+// cached hash and bucket)
+constexpr size_t MAP_NODE_OVERHEAD = 32;
+
+inline size_t incoming_mods_bytes(IncomingMods const& incoming) {
+  size_t bytes = sizeof(pair<const ChunkId, IncomingMods>) + MAP_NODE_OVERHEAD;
+  for (auto& [source, mods] : incoming) {
+    bytes += sizeof(pair<const ChunkId, ChunkMetaMod>) + MAP_NODE_OVERHEAD +
+             mods.capacity() * sizeof(Mod);
+  }
+  return bytes;
+}
+
+inline u64 incoming_mods_count(IncomingMods const& incoming) {
+  u64 count = 0;
+  for (auto& [source, mods] : incoming) count += mods.size();
+  return count;
+}
+
+bool structure_store_merge(StructureStore& store, ChunkId source,
+                           ChunkId target, ChunkMetaMod& mods) {
+  auto region_id = structure_region_of(target);
+  auto& shard = store.shards[structure_store_shard_index(region_id)];
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  auto [region_it, new_region] = shard.regions.try_emplace(region_id);
+  auto& region = region_it->second;
+  if (new_region) store.regions++;
+
+  auto& incoming = region.chunks[target];
+  auto it = incoming.find(source);
+  if (it != incoming.end() && it->second == mods) return false;
+
+  size_t bytes_before = incoming.empty() ? 0 : incoming_mods_bytes(incoming);
+  u64 mods_before = incoming_mods_count(incoming);
+  mods.shrink_to_fit();
+  incoming[source] = std::move(mods);
+  size_t bytes_after = incoming_mods_bytes(incoming);
+  u64 mods_after = incoming_mods_count(incoming);
+
+  region.bytes += bytes_after - bytes_before;
+  region.mods += mods_after - mods_before;
+  store.bytes += bytes_after - bytes_before;
+  store.mods += mods_after - mods_before;
+  return true;
+}
+
+IncomingMods structure_store_incoming(StructureStore const& store,
+                                      ChunkId target) {
+  auto region_id = structure_region_of(target);
+  auto& shard = store.shards[structure_store_shard_index(region_id)];
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  auto region = shard.regions.find(region_id);
+  if (region == shard.regions.end()) return {};
+  auto chunk = region->second.chunks.find(target);
+  if (chunk == region->second.chunks.end()) return {};
+  return chunk->second;
+}
+
+void structure_store_drop(StructureStore& store, ChunkId target,
+                          IncomingMods const& saved) {
+  auto region_id = structure_region_of(target);
+  auto& shard = store.shards[structure_store_shard_index(region_id)];
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  auto region_it = shard.regions.find(region_id);
+  if (region_it == shard.regions.end()) return;
+  auto& region = region_it->second;
+  auto chunk = region.chunks.find(target);
+  if (chunk == region.chunks.end()) return;
+
+  // a neighbour may have spilled more since the chunk was saved
+  auto& incoming = chunk->second;
+  size_t bytes_before = incoming_mods_bytes(incoming);
+  u64 mods_before = incoming_mods_count(incoming);
+  for (auto& [source, mods] : saved) {
+    auto it = incoming.find(source);
+    if (it != incoming.end() && it->second == mods) incoming.erase(it);
+  }
+  size_t bytes_after = incoming.empty() ? 0 : incoming_mods_bytes(incoming);
+  u64 mods_after = incoming_mods_count(incoming);
+  if (incoming.empty()) region.chunks.erase(chunk);
+
+  region.bytes -= bytes_before - bytes_after;
+  region.mods -= mods_before - mods_after;
+  store.bytes -= bytes_before - bytes_after;
+  store.mods -= mods_before - mods_after;
+}
+
+void structure_store_retain(StructureStore& store, i32 first_x, i32 first_y,
+                            i32 last_x, i32 last_y) {
+  auto first = structure_region_of({first_x - CHUNK_WIDTH,
+                                    first_y - CHUNK_LENGTH});
+  auto last = structure_region_of({last_x + CHUNK_WIDTH, last_y + CHUNK_LENGTH});
+  for (auto& shard : store.shards) {
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    for (auto it = shard.regions.begin(); it != shard.regions.end();) {
+      auto [x, y] = it->first;
+      if (x >= first.first && x <= last.first && y >= first.second &&
+          y <= last.second) {
+        ++it;
+        continue;
+      }
+      store.bytes -= it->second.bytes;
+      store.mods -= it->second.mods;
+      store.regions--;
+      store.regions_dropped++;
+      it = shard.regions.erase(it);
+    }
+  }
+}
+
+void structure_store_clear(StructureStore& store) {
+  for (auto& shard : store.shards) {
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    for (auto& [id, region] : shard.regions) {
+      store.bytes -= region.bytes;
+      store.mods -= region.mods;
+    }
+    store.regions -= shard.regions.size();
+    shard.regions.clear();
+  }
+}
@@ -0,0 +1,101 @@
+#ifndef STRUCTURE_STORE_HPP
+#define STRUCTURE_STORE_HPP
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#include "block.hpp"
+#include "util.hpp"
+
+// A structure block spilled into a chunk, at a position local to that chunk
+struct Mod {
+  u8 x;
+  u8 y;
+  u8 z;
+  BlockType block;
+
+  bool operator==(const Mod&) const = default;
+};
+static_assert(CHUNK_WIDTH <= 256 && CHUNK_LENGTH <= 256 && CHUNK_HEIGHT <= 256,
+              "Mod positions are stored in bytes");
+
+using ChunkMetaMod = vector<Mod>;
+// Structure blocks spilled into one chunk, by the chunk the structure grows
+// from. The map is ordered so they are always applied in the same order.
+using IncomingMods = std::map<ChunkId, ChunkMetaMod>;
+// Structure blocks a chunk places into its neighbours, by neighbour
+using ChunkSpill = unordered_map<ChunkId, ChunkMetaMod, hash_pair>;
+
+// side of a region, in chunks
+constexpr i32 STRUCTURE_REGION_CHUNKS = 32;
+constexpr u32 STRUCTURE_STORE_SHARDS = 16;
+
+// (x, y) of the region, in regions
+using StructureRegionId = pair<i32, i32>;
+
+// The pending structure blocks of the chunks of one region
+struct StructureRegion {
+  unordered_map<ChunkId, IncomingMods, hash_pair> chunks;
+  // estimated heap footprint of `chunks`
+  size_t bytes = 0;
+  u64 mods = 0;
+};
+
+struct StructureStoreShard {
+  mutable std::mutex mutex;
+  unordered_map<StructureRegionId, StructureRegion, hash_pair> regions;
+};
+
+// Structure blocks that chunks spilled into their neighbours, kept for when
+// the neighbour is generated (again). The blocks are grouped by the region of
+// the chunk they spill into, so the regions that no loaded chunk can need any
+// more are dropped at once. The regions are spread over shards with a lock
+// each, the generation workers rarely wait on each other to add their blocks.
+struct StructureStore {
+  std::array<StructureStoreShard, STRUCTURE_STORE_SHARDS> shards;
+
+  // statistics
+  std::atomic<size_t> bytes = 0;
+  std::atomic<u64> mods = 0;
+  std::atomic<u64> regions = 0;
+  std::atomic<u64> regions_dropped = 0;
+};
+
+inline StructureRegionId structure_region_of(ChunkId id) {
+  constexpr i32 w = STRUCTURE_REGION_CHUNKS * CHUNK_WIDTH;
+  constexpr i32 l = STRUCTURE_REGION_CHUNKS * CHUNK_LENGTH;
+  // rounded towards negative infinity
+  i32 x = id.first >= 0 ? id.first / w : (id.first - w + 1) / w;
+  i32 y = id.second >= 0 ? id.second / l : (id.second - l + 1) / l;
+  return {x, y};
+}
+
+inline u32 structure_store_shard_index(StructureRegionId region) {
+  u64 key = (u64)(u32)region.first << 32 | (u32)region.second;
+  return mix64(key) % STRUCTURE_STORE_SHARDS;
+}
+
+// Records the blocks `source` spills into `target`, taking `mods`. Returns
+// false when the store already had these blocks.
+bool structure_store_merge(StructureStore& store, ChunkId source,
+                           ChunkId target, ChunkMetaMod& mods);
+
+// The blocks spilled into the chunk, by source
+IncomingMods structure_store_incoming(StructureStore const& store,
+                                      ChunkId target);
+// Drops the blocks spilled into the chunk that are the same as `saved`, once
+// they are saved with it
+void structure_store_drop(StructureStore& store, ChunkId target,
+                          IncomingMods const& saved);
+
+// Drops the regions that neither the chunks from (first_x, first_y) to
+// (last_x, last_y) nor their neighbours lie in. The chunks of the dropped
+// regions are generated again along with their neighbours, which spill the
+// same blocks again.
+void structure_store_retain(StructureStore& store, i32 first_x, i32 first_y,
+                            i32 last_x, i32 last_y);
+void structure_store_clear(StructureStore& store);
+
+#endif
@@ -12,6 +12,30 @@ inline int round_to_nearest_16(int number) {
   return result;
 }
 
+// splitmix64 finalizer: mixes all bits of the input into all bits of the
+// output
+inline u64 mix64(u64 x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// A hash function used to hash a pair of any kind. The hashes are mixed, the
+// std::hash of an integer is the integer itself: xoring them maps (a, b) and
+// (b, a) to the same bucket, and chunk positions to multiples of 16.
+struct hash_pair {
+  template <class T1, class T2>
+  size_t operator()(const pair<T1, T2>& p) const {
+    auto hash1 = std::hash<T1>{}(p.first);
+    auto hash2 = std::hash<T2>{}(p.second);
+    return mix64(mix64(hash1) ^ hash2);
+  }
+};
+
+// World position of the first block of a chunk
+using ChunkId = pair<i32, i32>;
+inline ChunkId chunk_id_from_coords(int x, int y) { return make_pair(x, y); }
+
 // 2D vector wrapper around 1D vector
 template <typename T>
 class Vector2D : public std::vector<T> {
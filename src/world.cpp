@@ -1,14 +1,21 @@
 #include "world.hpp"
 
+#ifndef HEADLESS
 #include <GL/glew.h>
+#endif
 #include <fmt/core.h>
 
+#include <bit>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <unordered_set>
 
 #include "PerlinNoise/PerlinNoise.hpp"
+#include "byte_stream.hpp"
 #include "constants.hpp"
 #include "image.hpp"
+#include "logger.hpp"
+#include "png_stream.hpp"
 #include "util.hpp"
 
 using std::array;
@@ -20,113 +27,6 @@ float BLOCK_WIDTH = 2.0f;
 float BLOCK_LENGTH = BLOCK_WIDTH;
 float BLOCK_HEIGHT = BLOCK_WIDTH;
 
-inline Chunk *is_chunk_loaded(World &world, int x, int y) {
-  auto ch = world.loaded_chunks.find(chunk_id_from_coords(x, y));
-  bool loaded = ch != world.loaded_chunks.end();
-  // fmt::print("{},{} is loaded: {}\n", x, y, loaded);
-  return loaded ? ch->second : nullptr;
-}
-
-inline BlockType block_type_for_height(Biome &bk, int height, int maxHeight) {
-  int top = bk.maxHeight - BLOCKS_OF_AIR_ABOVE;
-
-  switch (bk.kind) {
-    case BiomeKind::Desert: {
-      if (height == maxHeight) {
-        return BlockType::Sand;
-      }
-      if (height > (top - 6)) {
-        return BlockType::Sand;
-      } else if (height > (top - 20)) {
-        return BlockType::Dirt;
-      } else if (height >= 0) {
-        return BlockType::Stone;
-      }
-    } break;
-
-    case BiomeKind::Grassland: {
-      if (height == maxHeight) {
-        return BlockType::TopGrass;
-      } else if (height > (top - 20)) {
-        return BlockType::Dirt;
-      } else if (height >= 0) {
-        return BlockType::Stone;
-      }
-    } break;
-
-    case BiomeKind::Tundra: {
-      if (height == maxHeight) {
-        return BlockType::Snow;
-      } else if (height > (top - 20)) {
-        return BlockType::Snow;
-      } else if (height >= 0) {
-        return BlockType::Stone;
-      }
-    } break;
-
-    case BiomeKind::Taiga: {
-      if (height == maxHeight) {
-        return BlockType::TopSnow;
-      } else if (height > (top - 20)) {
-        return BlockType::Dirt;
-      } else if (height >= 0) {
-        return BlockType::Stone;
-      }
-    } break;
-
-    case BiomeKind::Mountains: {
-      if (height > (top - 6)) {
-        return BlockType::Snow;
-      } else if (height > (top - 20)) {
-        return BlockType::Stone;
-      } else if (height >= 0) {
-        return BlockType::Stone;
-      }
-    } break;
-
-    case BiomeKind::Ocean: {
-      return BlockType::Sand;
-    } break;
-
-    case BiomeKind::Coast: {
-      return BlockType::Sand;
-    } break;
-
-    case BiomeKind::Forest: {
-      if (height == maxHeight) {
-        return BlockType::TopGrass;
-      } else if (height > (top - 20)) {
-        return BlockType::Dirt;
-      } else if (height >= 0) {
-        return BlockType::Stone;
-      }
-    } break;
-
-    case BiomeKind::Jungle: {
-      if (height == maxHeight) {
-        return BlockType::JungleTopGrass;
-      } else if (height > (top - 20)) {
-        return BlockType::Dirt;
-      } else if (height >= 0) {
-        return BlockType::Stone;
-      }
-    } break;
-
-    default:
-      return BlockType::Unknown;
-  }
-
-  return BlockType::Unknown;
-}
-
-uint32_t get_col_height(Block *col) {
-  int topBlockHeight = CHUNK_HEIGHT - 1;
-  while (topBlockHeight > 0 && col[topBlockHeight].type == BlockType::Air) {
-    topBlockHeight--;
-  }
-  return topBlockHeight;
-}
-
 inline glm::vec2 uv_for_block_type(BlockType bt) {
   // TODO: Implement this
   return {0.0, 0.0};
@@ -137,7 +37,8 @@ inline WorldPos chunk_global_to_local_pos(Chunk *chunk, WorldPos pos) {
 }
 
 inline Block chunk_get_block(Chunk *chunk, glm::ivec3 local_pos) {
-  return chunk->blocks[local_pos.x][local_pos.y][local_pos.z];
+  return chunk_blocks_get(chunk->blocks, local_pos.x, local_pos.y,
+                          local_pos.z);
 }
 
 inline Block chunk_get_block_at_global(Chunk *chunk, WorldPos pos) {
@@ -184,85 +85,91 @@ glm::vec2 block_type_texture_offset_for_face(int face) {
   return block_type_texture_offset((BlockType)(face + debugFaceTexturesOffset));
 }
 
-void make_cube_faces(ChunkMesh &mesh, float ao[6][4], float light[6][4],
+// corners of the faces of a cube, in order left, right, top, bottom, front,
+// back, as (x, height, y) offsets from its center. basic_vs.glsl has the
+// normals of the faces, in the same order.
+static const float cube_face_positions[6][4][3] = {
+    {{-1, -1, -1}, {-1, -1, +1}, {-1, +1, -1}, {-1, +1, +1}},
+    {{+1, -1, -1}, {+1, -1, +1}, {+1, +1, -1}, {+1, +1, +1}},
+    {{-1, +1, -1}, {-1, +1, +1}, {+1, +1, -1}, {+1, +1, +1}},
+    {{-1, -1, -1}, {-1, -1, +1}, {+1, -1, -1}, {+1, -1, +1}},
+    {{-1, -1, -1}, {-1, +1, -1}, {+1, -1, -1}, {+1, +1, -1}},
+    {{-1, -1, +1}, {-1, +1, +1}, {+1, -1, +1}, {+1, +1, +1}}};
+static const float cube_face_uvs[6][4][2] = {
+    {{0, 0}, {1, 0}, {0, 1}, {1, 1}},                                    //
+    {{1, 0}, {0, 0}, {1, 1}, {0, 1}}, {{0, 1}, {0, 0}, {1, 1}, {1, 0}},  //
+    {{0, 0}, {0, 1}, {1, 0}, {1, 1}}, {{0, 0}, {0, 1}, {1, 0}, {1, 1}},  //
+    {{1, 0}, {1, 1}, {0, 0}, {0, 1}}};
+// the axes, of the positions above, along which u and v of the face go
+static const int cube_face_uv_axes[6][2] = {{2, 1}, {2, 1}, {0, 2},
+                                            {0, 2}, {0, 1}, {0, 1}};
+// the positions above in the order of the vertices of a quad, whose
+// triangles are CHUNK_QUAD_INDICES
+static const int cube_face_quad_corners[6][4] = {
+    {0, 3, 2, 1}, {0, 3, 1, 2}, {0, 3, 2, 1},
+    {0, 3, 1, 2}, {0, 3, 2, 1}, {0, 3, 1, 2}};
+
+// the face on each side of a chunk, and the step to the neighbour it looks
+// into
+static const int chunk_side_faces[CHUNK_SIDES] = {0, 1, 4, 5};
+static const int chunk_side_steps[CHUNK_SIDES][2] = {
+    {-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+// The block at `u` along the side of the chunk and `height`, as
+// (x, height, y). `u` goes along the u of the face on the side.
+inline glm::ivec3 chunk_side_block(u32 side, int u, int height) {
+  auto &step = chunk_side_steps[side];
+  if (step[0] != 0) return {step[0] < 0 ? 0 : CHUNK_WIDTH - 1, height, u};
+  return {u, height, step[1] < 0 ? 0 : CHUNK_LENGTH - 1};
+}
+
+inline int chunk_side_width(u32 side) {
+  return chunk_side_steps[side][0] != 0 ? CHUNK_LENGTH : CHUNK_WIDTH;
+}
+
+// Appends the face `i` of the block at (x, height, y) in the chunk, stretched
+// over `size` blocks along each axis from there. The texture of the block is
+// repeated once per block.
+void make_face(ChunkMesh &mesh, ChunkQuads quads, int i, float ao[4],
+               float light[4], int x, int height, int y, glm::ivec3 size,
+               BlockType block_type) {
+  // has separate textures for top/side/bottom, in the atlas rows below its
+  // own
+  static const u32 complex_rows[6] = {1, 1, 0, 2, 1, 1};
+  u32 texture = (u32)block_type;
+  if (bt_is_complex(block_type)) {
+    texture += complex_rows[i] * (TEXTURE_WIDTH / TEXTURE_TILE_WIDTH);
+  }
+  int block[3] = {x, height, y};
+  bool indexed = quads == ChunkQuads::Indexed;
+  for (int v = 0; v < (indexed ? 4 : 6); v++) {
+    int j = cube_face_quad_corners[i][indexed ? v : CHUNK_QUAD_INDICES[v]];
+    auto &corner = cube_face_positions[i][j];
+    // the far corners move to the far block
+    glm::ivec3 pos;
+    for (int axis = 0; axis < 3; ++axis) {
+      pos[axis] = block[axis] + (corner[axis] > 0 ? size[axis] : 0);
+    }
+    auto &uv = cube_face_uvs[i][j];
+    mesh.push_back(vertex_pack(pos, i, uv[0] * size[cube_face_uv_axes[i][0]],
+                               uv[1] * size[cube_face_uv_axes[i][1]], texture,
+                               ao[j], light[j]));
+  }
+}
+
+void make_cube_faces(ChunkMesh &mesh, ChunkQuads quads, float ao[6][4],
+                     float light[6][4],
                      int left, int right, int top, int bottom, int front,
                      int back, int wleft, int wright, int wtop, int wbottom,
-                     int wfront, int wback, float x, float y, float z, float n,
+                     int wfront, int wback, int x, int height, int y,
                      BlockType block_type) {
-  // has separate textures for top/side/bottom
-  bool is_complex = bt_is_complex(block_type);
-  glm::vec2 texture_offset = block_type_texture_offset(block_type);
-  static const float positions[6][4][3] = {
-      {{-1, -1, -1}, {-1, -1, +1}, {-1, +1, -1}, {-1, +1, +1}},
-      {{+1, -1, -1}, {+1, -1, +1}, {+1, +1, -1}, {+1, +1, +1}},
-      {{-1, +1, -1}, {-1, +1, +1}, {+1, +1, -1}, {+1, +1, +1}},
-      {{-1, -1, -1}, {-1, -1, +1}, {+1, -1, -1}, {+1, -1, +1}},
-      {{-1, -1, -1}, {-1, +1, -1}, {+1, -1, -1}, {+1, +1, -1}},
-      {{-1, -1, +1}, {-1, +1, +1}, {+1, -1, +1}, {+1, +1, +1}}};
-  static const float normals[6][3] = {{-1, 0, 0}, {+1, 0, 0}, {0, +1, 0},
-                                      {0, -1, 0}, {0, 0, -1}, {0, 0, +1}};
-  static const float uvs[6][4][2] = {
-      {{0, 0}, {1, 0}, {0, 1}, {1, 1}},                                    //
-      {{1, 0}, {0, 0}, {1, 1}, {0, 1}}, {{0, 1}, {0, 0}, {1, 1}, {1, 0}},  //
-      {{0, 0}, {0, 1}, {1, 0}, {1, 1}}, {{0, 0}, {0, 1}, {1, 0}, {1, 1}},  //
-      {{1, 0}, {1, 1}, {0, 0}, {0, 1}}};
-  static const float indices[6][6] = {{0, 3, 2, 0, 1, 3}, {0, 3, 1, 0, 2, 3},
-                                      {0, 3, 2, 0, 1, 3}, {0, 3, 1, 0, 2, 3},
-                                      {0, 3, 2, 0, 1, 3}, {0, 3, 1, 0, 2, 3}};
-  float s = TEXTURE_TILE_WIDTH_F;
-  float a = 0 + 1 / 2048.0;
-  float b = s - 1 / 2048.0;
   int faces[6] = {left, right, top, bottom, front, back};
-  static float complex_uv_offset[6][2] = {
-      {0, -(float)TEXTURE_TILE_HEIGHT / TEXTURE_HEIGHT},        // left
-      {0, -(float)TEXTURE_TILE_HEIGHT / TEXTURE_HEIGHT},        // right
-      {0, 0},                                                   // top
-      {0, -((float)TEXTURE_TILE_HEIGHT * 2) / TEXTURE_HEIGHT},  // bottom
-      {0, -(float)TEXTURE_TILE_HEIGHT / TEXTURE_HEIGHT},        // front
-      {0, -(float)TEXTURE_TILE_HEIGHT / TEXTURE_HEIGHT}         // back
-  };
-  static float no_uv_offset[6][2] = {
-      {0, 0},  // left
-      {0, 0},  // right
-      {0, 0},  // top
-      {0, 0},  // bottom
-      {0, 0},  // front
-      {0, 0}   // back
-  };
-  auto *extra_uv_offset = no_uv_offset;
-  if (is_complex) {
-    extra_uv_offset = complex_uv_offset;
-  } else {
-    extra_uv_offset = no_uv_offset;
-  }
   for (int i = 0; i < 6; i++) {
     if (faces[i] == 0) {
       continue;
     }
-    for (int v = 0; v < 6; v++) {
-      VertexData vd;
-      int j = indices[i][v];
-      auto xpos = positions[i][j][0];
-      vd.pos.x = x + n * xpos;
-      auto ypos = positions[i][j][1];
-      vd.pos.y = y + n * ypos;
-      auto zpos = positions[i][j][2];
-      vd.pos.z = z + n * zpos;
-      vd.normal.x = normals[i][0];
-      vd.normal.y = normals[i][1];
-      vd.normal.z = normals[i][2];
-      auto xoffset = texture_offset.x + extra_uv_offset[i][0];
-      auto yoffset = texture_offset.y + extra_uv_offset[i][1];
-      vd.uv = {
-          xoffset + (uvs[i][j][0] ? b : a),  // x
-          yoffset + (uvs[i][j][1] ? b : a)
-          // y
-      };
-      vd.ao = ao[i][j];
-      vd.light = light[i][j];
-      // vd.uv.r = dv + (uvs[i][j][1] ? b : a);
-      mesh.push_back(vd);
-    }
+    make_face(mesh, quads, i, ao[i], light[i], x, height, y, {1, 1, 1},
+              block_type);
   }
 }
 
@@ -278,48 +185,46 @@ auto W = CHUNK_WIDTH;
 auto H = CHUNK_HEIGHT;
 auto L = CHUNK_LENGTH;
 
-inline bool IS_TB_BACK_OF(Chunk &chunk, int x, int y, int z) {
-  const auto neary = min(L - 1, y + 1);
-  if (neary == L - 1) return true;
-  return IS_TB_AT(chunk, x, neary, z);
+// Whether the block next to the block at (x, y, z) on that side is
+// transparent. The faces on the sides of the chunk are meshed by
+// gen_chunk_side_mesh against the neighbours, they are not shown here; the
+// top and the bottom of the world are transparent.
+inline bool IS_TB_BACK_OF(DenseChunkBlocks const &chunk, int x, int y,
+                         int z) {
+  if (y == L - 1) return false;
+  return IS_TB_AT(chunk, x, y + 1, z);
 }
 
-inline bool IS_TB_FRONT_OF(Chunk &chunk, int x, int y, int z) {
-  const auto neary = max(0, y - 1);
-  if (neary == 0) return true;
-  return IS_TB_AT(chunk, x, neary, z);
+inline bool IS_TB_FRONT_OF(DenseChunkBlocks const &chunk, int x, int y,
+                         int z) {
+  if (y == 0) return false;
+  return IS_TB_AT(chunk, x, y - 1, z);
 }
 
-inline bool IS_TB_RIGHT_OF(Chunk &chunk, int x, int y, int z) {
-  const auto nearx = min(L - 1, x + 1);
-  if (nearx == L - 1) return true;
-  return IS_TB_AT(chunk, nearx, y, z);
+inline bool IS_TB_RIGHT_OF(DenseChunkBlocks const &chunk, int x, int y,
+                         int z) {
+  if (x == W - 1) return false;
+  return IS_TB_AT(chunk, x + 1, y, z);
 }
 
-inline bool IS_TB_LEFT_OF(Chunk &chunk, int x, int y, int z) {
-  const auto nearx = max(0, x - 1);
-  if (nearx == 0) return true;
-  return IS_TB_AT(chunk, nearx, y, z);
+inline bool IS_TB_LEFT_OF(DenseChunkBlocks const &chunk, int x, int y,
+                         int z) {
+  if (x == 0) return false;
+  return IS_TB_AT(chunk, x - 1, y, z);
 }
 
-inline bool IS_TB_TOP_OF(Chunk &chunk, int x, int y, int z) {
-  const auto nearz = min(H - 1, z + 1);
-  if (nearz == H - 1) return true;
-  return IS_TB_AT(chunk, x, y, nearz);
+inline bool IS_TB_TOP_OF(DenseChunkBlocks const &chunk, int x, int y,
+                         int z) {
+  if (z == H - 1) return true;
+  return IS_TB_AT(chunk, x, y, z + 1);
 }
 
-inline bool IS_TB_BOTTOM_OF(Chunk &chunk, int x, int y, int z) {
-  const auto nearz = max(0, z - 1);
-  if (nearz == 0) return true;
-  return IS_TB_AT(chunk, x, y, nearz);
+inline bool IS_TB_BOTTOM_OF(DenseChunkBlocks const &chunk, int x, int y,
+                         int z) {
+  if (z == 0) return true;
+  return IS_TB_AT(chunk, x, y, z - 1);
 }
 
-struct PointBiomeNoise {
-  float height_noise;
-  float rainfall_noise;
-  float temp_noise;
-};
-
 inline BiomeKind biome_noise_to_kind_at_point(PointBiomeNoise bn) {
   auto temp_noise = bn.temp_noise;
   auto rainfall_noise = bn.rainfall_noise;
@@ -370,35 +275,63 @@ inline BiomeKind biome_noise_to_kind_at_point(PointBiomeNoise bn) {
   }
 }
 
-inline float temperature_noise_at(World &world, int x, int y) {
-  return (world.temperature_noise.noise(4, x, y) + 1.0f) / 2.0f;
+constexpr u32 TEMPERATURE_OCTAVES = 4;
+constexpr u32 RAINFALL_OCTAVES = 2;
+constexpr u32 SIMPLE_HEIGHT_OCTAVES = 2;
+
+// maps a noise sample from [-1, 1] to [0, 1]
+inline float unit_noise(float noise) { return (noise + 1.0f) / 2.0f; }
+
+// Fills the height, temperature and rainfall tiles of a width x length grid
+// of points `step` blocks apart, one noise tile per field
+inline void climate_noise_tile(World const &world, i32 x0, i32 y0, u32 width,
+                               u32 length, i32 step, float *height,
+                               float *temperature, float *rainfall) {
+  world.height_noise.noise_tile(SIMPLE_HEIGHT_OCTAVES, x0, y0, width, length,
+                                height, step);
+  world.temperature_noise.noise_tile(TEMPERATURE_OCTAVES, x0, y0, width,
+                                     length, temperature, step);
+  world.rainfall_noise.noise_tile(RAINFALL_OCTAVES, x0, y0, width, length,
+                                  rainfall, step);
 }
 
-inline float rainfall_noise_at(World &world, int x, int y) {
-  return (world.rainfall_noise.noise(2, x, y) + 1.0f) / 2.0f;
+inline PointBiomeNoise climate_at_point(World const &world, i32 x, i32 y) {
+  return PointBiomeNoise{
+      .height_noise =
+          unit_noise(world.height_noise.noise(SIMPLE_HEIGHT_OCTAVES, x, y)),
+      .rainfall_noise =
+          unit_noise(world.rainfall_noise.noise(RAINFALL_OCTAVES, x, y)),
+      .temp_noise =
+          unit_noise(world.temperature_noise.noise(TEMPERATURE_OCTAVES, x, y)),
+  };
 }
 
-inline float simple_height_noise_at(World &world, i32 x, i32 y) {
-  return (world.height_noise.noise(2, x, y) + 1.0f) / 2.0f;
+// Evaluates the climate of all columns of the chunk
+void gen_chunk_climate(World const &world, Chunk &chunk) {
+  constexpr u32 n = CHUNK_WIDTH * CHUNK_LENGTH;
+  float height[n];
+  float temperature[n];
+  float rainfall[n];
+  climate_noise_tile(world, chunk.x, chunk.y, CHUNK_WIDTH, CHUNK_LENGTH, 1,
+                     height, temperature, rainfall);
+  auto &climate = chunk.climate;
+  for (int x = 0; x < CHUNK_WIDTH; ++x) {
+    for (int y = 0; y < CHUNK_LENGTH; ++y) {
+      auto i = x * CHUNK_LENGTH + y;
+      PointBiomeNoise bn{
+          .height_noise = unit_noise(height[i]),
+          .rainfall_noise = unit_noise(rainfall[i]),
+          .temp_noise = unit_noise(temperature[i]),
+      };
+      climate.noise[x][y] = bn;
+      climate.biome[x][y] = biome_noise_to_kind_at_point(bn);
+    }
+  }
 }
 
 inline Biome &biome_at_point(World &world, i32 x, i32 y) {
-  auto height_noise = simple_height_noise_at(world, x, y);
-  auto temp_noise = temperature_noise_at(world, x, y);
-  auto rainfall_noise = rainfall_noise_at(world, x, y);
-  PointBiomeNoise bn{
-      .height_noise = height_noise,
-      .rainfall_noise = rainfall_noise,
-      .temp_noise = temp_noise,
-  };
-  auto kind = biome_noise_to_kind_at_point(bn);
-  auto it = world.biomes_by_kind.find(kind);
-  if (it == world.biomes_by_kind.end()) {
-    logger::error(
-        fmt::format("Couldn't find biome info for biome with id={}\n", kind));
-    return it->second;
-  }
-  return it->second;
+  auto kind = biome_noise_to_kind_at_point(climate_at_point(world, x, y));
+  return world.biomes[kind];
 }
 
 inline float blerp(float q11, float q12, float q21, float q22, float x1,
@@ -415,40 +348,6 @@ inline float blerp(float q11, float q12, float q21, float q22, float x1,
           q22 * xx1 * yy1);
 }
 
-// get the height noise for a particular x,y point on the world plane
-inline float height_noise_at_blerp(World &world, int x, int y) {
-  // calculate biome noise for the adjacent four points
-
-  u32 oct = 4;
-  u32 distance = 16;
-  float xf = (float)x;
-  float yf = (float)y;
-
-  const i32 x1 = x - distance;
-  float x1f = (float)x1;
-  Biome &leftBiome = biome_at_point(world, x1, y);
-  float leftNoise = leftBiome.noise.noise(oct, x1, y);
-
-  const i32 x2 = x + distance;
-  float x2f = (float)x2;
-  Biome &rightBiome = biome_at_point(world, x2, y);
-  float rightNoise = rightBiome.noise.noise(oct, x2, y);
-
-  const i32 y1 = y - distance;
-  float y1f = (float)y1;
-  Biome &backBiome = biome_at_point(world, x, y1);
-  float backNoise = backBiome.noise.noise(oct, x, y1);
-
-  const i32 y2 = y + distance;
-  float y2f = (float)y2;
-  Biome &frontBiome = biome_at_point(world, x, y2);
-  float frontNoise = frontBiome.noise.noise(oct, x, y2);
-
-  auto actual_noise = blerp(leftNoise, rightNoise, backNoise, frontNoise, x1f,
-                            x2f, y1f, y2f, xf, yf);
-  return (actual_noise + 1.0f) / 2.0f;
-}
-
 inline float biome_influence_at_point(Biome const &biome, int x, int y,
                                       PointBiomeNoise bn) {
   switch (biome.kind) {
@@ -490,39 +389,139 @@ inline float biome_influence_at_point(Biome const &biome, int x, int y,
   }
 }
 
-// get the height noise for a particular x,y point on the world plane
-inline u32 height_noise_at(World &world, int x, int y, PointBiomeNoise bn) {
-  float actual_noise = 0.0f;
-  u32 oct = 4;
+constexpr u32 BIOME_HEIGHT_OCTAVES = 4;
 
-  float total_weight = 0.0f;
+// Biomes with less influence than this at a point are left out of the height
+// blend there, and their height noise is not sampled
+constexpr float NEGLIGIBLE_BIOME_WEIGHT = 1e-3f;
+
+inline void biome_weights_at(World const &world, int x, int y,
+                             PointBiomeNoise bn,
+                             float weights[BiomeKind::Count]) {
+  for (u32 i = 0; i < BiomeKind::Count; ++i) {
+    auto &biome = world.biomes[i];
+    weights[i] = biome_influence_at_point(biome, x, y, bn);
+  }
+}
 
-  u32 biomes_amount = BiomeKind::Count;
-  for (u32 i = 0; i < biomes_amount; ++i) {
+// Weighted average of the biome heights at a point. `biome_noise(kind)` gives
+// the height noise of a biome in [0, 1] and is only called for biomes with a
+// non-negligible weight.
+template <typename BiomeNoise>
+inline float blend_biome_heights(World const &world,
+                                 float const weights[BiomeKind::Count],
+                                 BiomeNoise biome_noise) {
+  float actual_noise = 0.0f;
+  float total_weight = 0.0f;
+  for (u32 i = 0; i < BiomeKind::Count; ++i) {
+    float weight = weights[i];
+    if (weight < NEGLIGIBLE_BIOME_WEIGHT) continue;
     auto bk = (BiomeKind)i;
-    auto &biome = world.biomes_by_kind[bk];
-    float biome_noise = (biome.noise.noise(oct, x, y) + 1.0f) / 2.0f;
-    float weight = biome_influence_at_point(biome, x, y, bn);
-    // fmt::print("biome influence {} at {}, {} = {}\n", bk, x, y, weight);
     total_weight += weight;
-    auto pn = biome_noise * weight * 1.8f;
-    // fmt::print("pn={}\n", pn);
-    actual_noise += pn * biome.maxHeight;
+    auto pn = biome_noise(bk) * weight * 1.8f;
+    actual_noise += pn * world.biomes[bk].maxHeight;
   }
-  float total = actual_noise / total_weight;
-  // auto noise = (total + 1.0f) / 2.0f;
-  // fmt::print("height={}\n", total);
+  return actual_noise / total_weight;
+}
 
+// get the height noise for a particular x,y point on the world plane
+inline u32 height_noise_at(World const &world, int x, int y,
+                           PointBiomeNoise bn) {
+  float weights[BiomeKind::Count];
+  biome_weights_at(world, x, y, bn, weights);
+  float total = blend_biome_heights(world, weights, [&](BiomeKind bk) {
+    auto &noise = world.biomes[bk].noise;
+    return unit_noise(noise.noise(BIOME_HEIGHT_OCTAVES, x, y));
+  });
   return (u32)total;
 }
 
-inline bool is_point_outside_chunk_boundaries(int x, int y) {
-  return x < 0 || x > CHUNK_WIDTH || y < 0 || y > CHUNK_LENGTH;
+constexpr int HEIGHT_LATTICE_STEP = 4;
+// lattice points per chunk side, the last one is shared with the neighbour
+constexpr int HEIGHT_LATTICE_W = CHUNK_WIDTH / HEIGHT_LATTICE_STEP + 1;
+constexpr int HEIGHT_LATTICE_L = CHUNK_LENGTH / HEIGHT_LATTICE_STEP + 1;
+static_assert(CHUNK_WIDTH % HEIGHT_LATTICE_STEP == 0 &&
+              CHUNK_LENGTH % HEIGHT_LATTICE_STEP == 0);
+
+// HeightBlending::Lattice: blends the biome heights only on a lattice aligned
+// to HEIGHT_LATTICE_STEP global blocks and interpolates the columns between
+// the lattice points bilinearly. Chunks sharing an edge share its lattice
+// points, so the terrain stays continuous across chunk borders.
+void gen_lattice_heights(World const &world, Chunk &chunk,
+                         u32 heights[CHUNK_WIDTH][CHUNK_LENGTH]) {
+  constexpr u32 n = HEIGHT_LATTICE_W * HEIGHT_LATTICE_L;
+  constexpr i32 step = HEIGHT_LATTICE_STEP;
+  float height[n];
+  float temperature[n];
+  float rainfall[n];
+  climate_noise_tile(world, chunk.x, chunk.y, HEIGHT_LATTICE_W,
+                     HEIGHT_LATTICE_L, step, height, temperature, rainfall);
+
+  float weights[n][BiomeKind::Count];
+  bool biome_used[BiomeKind::Count] = {false};
+  for (u32 i = 0; i < n; ++i) {
+    PointBiomeNoise bn{
+        .height_noise = unit_noise(height[i]),
+        .rainfall_noise = unit_noise(rainfall[i]),
+        .temp_noise = unit_noise(temperature[i]),
+    };
+    i32 x = chunk.x + (i / HEIGHT_LATTICE_L) * step;
+    i32 y = chunk.y + (i % HEIGHT_LATTICE_L) * step;
+    biome_weights_at(world, x, y, bn, weights[i]);
+    for (u32 k = 0; k < BiomeKind::Count; ++k) {
+      biome_used[k] |= weights[i][k] >= NEGLIGIBLE_BIOME_WEIGHT;
+    }
+  }
+
+  // one noise tile per biome that matters anywhere on the lattice
+  float biome_noise[BiomeKind::Count][n];
+  for (u32 k = 0; k < BiomeKind::Count; ++k) {
+    if (!biome_used[k]) continue;
+    auto &noise = world.biomes[k].noise;
+    noise.noise_tile(BIOME_HEIGHT_OCTAVES, chunk.x, chunk.y, HEIGHT_LATTICE_W,
+                     HEIGHT_LATTICE_L, biome_noise[k], step);
+  }
+
+  float lattice[HEIGHT_LATTICE_W][HEIGHT_LATTICE_L];
+  for (u32 i = 0; i < n; ++i) {
+    lattice[i / HEIGHT_LATTICE_L][i % HEIGHT_LATTICE_L] =
+        blend_biome_heights(world, weights[i], [&](BiomeKind bk) {
+          return unit_noise(biome_noise[bk][i]);
+        });
+  }
+
+  for (int x = 0; x < CHUNK_WIDTH; ++x) {
+    int lx = x / step;
+    float x1 = (float)(lx * step);
+    for (int y = 0; y < CHUNK_LENGTH; ++y) {
+      int ly = y / step;
+      float y1 = (float)(ly * step);
+      float h = blerp(lattice[lx][ly], lattice[lx][ly + 1],
+                      lattice[lx + 1][ly], lattice[lx + 1][ly + 1], x1,
+                      x1 + step, y1, y1 + step, (float)x, (float)y);
+      heights[x][y] = (u32)h;
+    }
+  }
 }
 
-const char *get_biome_name_at(World &world, WorldPos pos) {
-  const auto &biome = biome_at_point(world, pos.x, pos.z);
-  return biome.name;
+// Terrain height of every column of the chunk, according to
+// world.height_blending
+void gen_chunk_heights(World const &world, Chunk &chunk,
+                       u32 heights[CHUNK_WIDTH][CHUNK_LENGTH]) {
+  if (world.height_blending == HeightBlending::Lattice) {
+    gen_lattice_heights(world, chunk, heights);
+    return;
+  }
+  for (int x = 0; x < CHUNK_WIDTH; ++x) {
+    for (int y = 0; y < CHUNK_LENGTH; ++y) {
+      heights[x][y] = height_noise_at(world, chunk.x + x, chunk.y + y,
+                                      chunk.climate.noise[x][y]);
+    }
+  }
+}
+
+inline bool is_point_outside_chunk_boundaries(int x, int y) {
+  return x < 0 || x >= CHUNK_WIDTH || y < 0 || y >= CHUNK_LENGTH;
 }
 
 inline WorldPos chunk_local_to_global_pos(Chunk &chunk, i32 x, i32 y, i32 z) {
@@ -539,72 +538,66 @@ ChunkId chunk_pos_for_coords(WorldPos pos) {
 }
 
 Chunk *find_chunk_with_pos(World &world, WorldPos pos) {
-  auto id = chunk_pos_for_coords(pos);
-  auto chunk = world.loaded_chunks.find(id);
-  if (chunk == world.loaded_chunks.end()) return nullptr;
-  return chunk->second;
+  return chunk_map_find(world.loaded_chunks, chunk_pos_for_coords(pos));
 }
 
-inline ChunkId chunk_id(Chunk &chunk) {
-  return chunk_id_from_coords(chunk.x, chunk.y);
+const char *get_biome_name_at(World &world, WorldPos pos) {
+  // the player position is (x, height, y)
+  auto id = chunk_pos_for_coords({pos.x, pos.z, 0});
+  auto *chunk = is_chunk_loaded(world, id.first, id.second);
+  if (chunk != nullptr) {
+    // the climate is written with the blocks while the chunk is generated,
+    // the render thread does not wait for it
+    std::unique_lock<std::mutex> lock(chunk->blocks_mutex, std::try_to_lock);
+    if (!lock.owns_lock() || chunk->is_being_generated) return "unknown";
+    auto kind = chunk->climate.biome[pos.x - chunk->x][pos.z - chunk->y];
+    return world.biomes[kind].name;
+  }
+  const auto &biome = biome_at_point(world, pos.x, pos.z);
+  return biome.name;
 }
 
-inline bool make_chunk_dirty_if_exists_at(World &world, ChunkId id) {
-  auto chunk = world.loaded_chunks.find(id);
-  if (chunk == world.loaded_chunks.end()) return false;
-  chunk->second->is_dirty = true;
-  return true;
+inline ChunkId chunk_id(Chunk &chunk) {
+  return chunk_id_from_coords(chunk.x, chunk.y);
 }
 
-inline void world_add_chunk_meta(World &world, Chunk &chunk, ChunkPos lpos,
-                                 BlockType block) {
-  WorldPos gpos{lpos.x + chunk.x, lpos.y + chunk.y, lpos.z};
-  auto id = chunk_pos_for_coords(gpos);
-  ChunkPos lpos_new{gpos.x - id.first, gpos.y - id.second, gpos.z};
-  Mod mod{
-      .pos = lpos_new,
-      .block = block,
-  };
-  world.meta[id].push_back(mod);
-}
+// State of one gen_chunk call, passed down to the structure builders
+struct ChunkGenContext {
+  World const &world;
+  Chunk &chunk;
+  DenseChunkBlocks &blocks;
+  ChunkRng rng;
+  // blocks placed outside of the chunk
+  ChunkSpill &spill;
+};
 
-inline void chunk_place_block(World &world, Chunk &chunk, i32 x, i32 y, i32 z,
+inline void chunk_place_block(ChunkGenContext &ctx, i32 x, i32 y, i32 z,
                               BlockType block) {
+  // trees on the highest columns grow out of the world
+  if (z < 0 || z >= CHUNK_HEIGHT) return;
   auto isOutsideChunkBoundaries = is_point_outside_chunk_boundaries(x, y);
   if (isOutsideChunkBoundaries) {
-    world_add_chunk_meta(world, chunk, {x, y, z}, block);
+    auto gpos = chunk_local_to_global_pos(ctx.chunk, x, y, z);
+    auto id = chunk_pos_for_coords(gpos);
+    Mod mod{
+        .x = (u8)(gpos.x - id.first),
+        .y = (u8)(gpos.y - id.second),
+        .z = (u8)z,
+        .block = block,
+    };
+    ctx.spill[id].push_back(mod);
   } else {
-    CHUNK_AT(chunk, x, y, z).type = block;
+    CHUNK_AT(ctx.blocks, x, y, z).type = block;
+    chunk_heightmap_update(ctx.chunk.heights, ctx.blocks, x, y, z, block);
   }
 }
 
-void gen_column_at(World &world, Block *output, int x, int y) {
-  auto height_noise = simple_height_noise_at(world, x, y);
-  auto temp_noise = temperature_noise_at(world, x, y);
-  auto rainfall_noise = rainfall_noise_at(world, x, y);
-  PointBiomeNoise bn{.height_noise = height_noise,
-                     .rainfall_noise = rainfall_noise,
-                     .temp_noise = temp_noise};
-  auto kind = biome_noise_to_kind_at_point(bn);
-  auto &bk = world.biomes_by_kind[kind];
-  // auto biome_height_noise = bk.noise.fractal(16, x, y);
-  // int maxHeight = bk.maxHeight;
-  // int columnHeight = noise * (float)maxHeight;
-  auto noise = height_noise_at(world, x, y, bn);
-  int columnHeight = noise;
-  for (int height = columnHeight - 1; height >= 0; --height) {
-    Block block;
-    block.type = block_type_for_height(bk, height, columnHeight - 1);
-    output[height] = block;
-  }
-  while (columnHeight < WATER_LEVEL) {
-    output[columnHeight].type = BlockType::Water;
-    columnHeight++;
-  }
-  // fill the rest with air
-  for (int i = columnHeight; i < CHUNK_HEIGHT; ++i) {
-    output[i].type = BlockType::Air;
-  }
+void gen_column_at(World const &world, Block *output, BiomeKind kind,
+                   int columnHeight) {
+  with_biome(kind, [&](auto tag) {
+    fill_biome_column<decltype(tag)::value>(world.biomes[kind], output,
+                                            columnHeight);
+  });
 }
 
 bool can_tree_grow_on(BlockType bt) {
@@ -626,19 +619,18 @@ bool can_tree_grow_on(BlockType bt) {
   }
 }
 
-void build_oak_tree_at(World &world, Chunk &chunk, int x, int y) {
-  auto col = &CHUNK_COL_AT(chunk, x, y);
-  auto topBlockHeight = get_col_height(col);
+void build_oak_tree_at(ChunkGenContext &ctx, int x, int y) {
+  auto topBlockHeight = chunk_heightmap_top_solid(ctx.chunk.heights, x, y);
   // start building a tree
   auto height = map(0.0f, 1.0f, MIN_TREE_HEIGHT, MAX_TREE_HEIGHT,
-                    world.tree_structure_noise());
+                    ctx.rng.next_float());
   auto treeTopHeight = topBlockHeight + height;
   auto h = topBlockHeight;
   // crown
   auto bottomRadius = round(map(0.0f, 1.0f, TREE_MIN_RADIUS, TREE_MAX_RADIUS,
-                                world.tree_structure_noise()));
+                                ctx.rng.next_float()));
   u32 crownHeight = round(map(0.0f, 1.0f, CROWN_MIN_HEIGHT, CROWN_MAX_HEIGHT,
-                              world.tree_structure_noise()));
+                              ctx.rng.next_float()));
   u32 crownBottom = treeTopHeight - round((float)crownHeight / 2.0f);
   u32 crownTop = crownBottom + crownHeight;
 
@@ -653,31 +645,23 @@ void build_oak_tree_at(World &world, Chunk &chunk, int x, int y) {
     auto endY = y + radius;
     for (int cx = startX; cx <= endX; ++cx) {
       for (int cy = startY; cy <= endY; ++cy) {
-        auto isOutsideChunkBoundaries =
-            is_point_outside_chunk_boundaries(cx, cy);
-        if (isOutsideChunkBoundaries) {
-          // TODO: Transfer this information to the chunk to be
-          // rendered with this block through some global state.
-        } else {
-          // append the block
-          // the further from the center, the less likely to have
-          // leaves here
-          // minus one because we don't count the middle
-          i32 dx = abs(cx - x) - 1;
-          i32 dy = abs(cy - y) - 1;
-          u32 distanceFromCenter2 = abs(dx * dx + dy * dy);
-          float distanceFromCenterProp =
-              (float)distanceFromCenter2 / (float)radius2;
-          // k is the base chance of leaves appearing on the edge
-          float k = -0.05;
-          float unlikelinessOfHavingLeavesBasedOnRadius =
-              max(0.0f, distanceFromCenterProp - k);
-          float noise = world.tree_noise(cx, cy);
-          auto needBlockHere = noise > unlikelinessOfHavingLeavesBasedOnRadius;
-          if (needBlockHere) {
-            chunk_place_block(world, chunk, cx, cy, crownBottom,
-                              BlockType::Leaves);
-          }
+        // append the block
+        // the further from the center, the less likely to have
+        // leaves here
+        // minus one because we don't count the middle
+        i32 dx = abs(cx - x) - 1;
+        i32 dy = abs(cy - y) - 1;
+        u32 distanceFromCenter2 = abs(dx * dx + dy * dy);
+        float distanceFromCenterProp =
+            (float)distanceFromCenter2 / (float)radius2;
+        // k is the base chance of leaves appearing on the edge
+        float k = -0.05;
+        float unlikelinessOfHavingLeavesBasedOnRadius =
+            max(0.0f, distanceFromCenterProp - k);
+        float noise = ctx.rng.next_float();
+        auto needBlockHere = noise > unlikelinessOfHavingLeavesBasedOnRadius;
+        if (needBlockHere) {
+          chunk_place_block(ctx, cx, cy, crownBottom, BlockType::Leaves);
         }
       }
     }
@@ -685,26 +669,25 @@ void build_oak_tree_at(World &world, Chunk &chunk, int x, int y) {
 
   // stump
   for (; h < treeTopHeight; ++h) {
-    chunk_place_block(world, chunk, x, y, h, BlockType::Wood);
+    chunk_place_block(ctx, x, y, h, BlockType::Wood);
   }
 }
 
-void build_jungle_tree(World &world, Chunk &chunk, int x, int y) {
-  auto col = &CHUNK_COL_AT(chunk, x, y);
-  auto topBlockHeight = get_col_height(col);
+void build_jungle_tree(ChunkGenContext &ctx, int x, int y) {
+  auto topBlockHeight = chunk_heightmap_top_solid(ctx.chunk.heights, x, y);
   // start building a tree
   auto height = map(0.0f, 1.0f, MIN_JUNGLE_TREE_HEIGHT, MAX_JUNGLE_TREE_HEIGHT,
-                    world.tree_structure_noise());
+                    ctx.rng.next_float());
   auto treeTopHeight = topBlockHeight + height;
   auto h = topBlockHeight;
 
   // crown
   auto bottomRadius =
       round(map(0.0f, 1.0f, JUNGLE_TREE_MIN_RADIUS, JUNGLE_TREE_MAX_RADIUS,
-                world.tree_structure_noise()));
+                ctx.rng.next_float()));
   u32 crownHeight =
       round(map(0.0f, 1.0f, JUNGLE_CROWN_MIN_HEIGHT, JUNGLE_CROWN_MAX_HEIGHT,
-                world.tree_structure_noise()));
+                ctx.rng.next_float()));
   u32 crownBottom = treeTopHeight - round((float)crownHeight / 2.0f);
   u32 crownTop = crownBottom + crownHeight;
   for (; crownBottom <= crownTop; ++crownBottom) {
@@ -729,10 +712,10 @@ void build_jungle_tree(World &world, Chunk &chunk, int x, int y) {
         float k = -0.05;
         float unlikelinessOfHavingLeavesBasedOnRadius =
             max(0.0f, distanceFromCenterProp - k);
-        float noise = world.tree_noise(cx, cy);
+        float noise = ctx.rng.next_float();
         auto needBlockHere = noise > unlikelinessOfHavingLeavesBasedOnRadius;
         if (needBlockHere) {
-          chunk_place_block(world, chunk, cx, cy, crownBottom,
+          chunk_place_block(ctx, cx, cy, crownBottom,
                             BlockType::JungleTreeLeaves);
         }
       }
@@ -745,27 +728,26 @@ void build_jungle_tree(World &world, Chunk &chunk, int x, int y) {
   for (int xx = x; xx < x + TREE_STUMP_RADIUS; ++xx) {
     for (int yy = y; yy < y + TREE_STUMP_RADIUS; ++yy) {
       for (auto h = initialH; h < treeTopHeight; ++h) {
-        chunk_place_block(world, chunk, xx, yy, h, BlockType::JungleWood);
+        chunk_place_block(ctx, xx, yy, h, BlockType::JungleWood);
       }
     }
   }
 }
 
-void build_pine_tree_at(World &world, Chunk &chunk, int x, int y) {
-  auto col = &CHUNK_COL_AT(chunk, x, y);
-  auto topBlockHeight = get_col_height(col);
+void build_pine_tree_at(ChunkGenContext &ctx, int x, int y) {
+  auto topBlockHeight = chunk_heightmap_top_solid(ctx.chunk.heights, x, y);
   // start building a tree
   auto height = map(0.0f, 1.0f, MIN_PINE_TREE_HEIGHT, MAX_PINE_TREE_HEIGHT,
-                    world.tree_structure_noise());
+                    ctx.rng.next_float());
   auto treeTopHeight = topBlockHeight + height;
   auto h = topBlockHeight;
   // crown
   auto maxRadius =
       round(map(0.0f, 1.0f, PINE_TREE_MIN_RADIUS, PINE_TREE_MAX_RADIUS,
-                world.tree_structure_noise()));
+                ctx.rng.next_float()));
   u32 crownHeight =
       round(map(0.0f, 1.0f, PINE_CROWN_MIN_HEIGHT, PINE_CROWN_MAX_HEIGHT,
-                world.tree_structure_noise()));
+                ctx.rng.next_float()));
   u32 crownBottom = treeTopHeight - round((float)crownHeight / 2.0f);
   u32 crownTop = crownBottom + crownHeight;
   auto radiusMax2 = maxRadius * maxRadius;
@@ -797,10 +779,10 @@ void build_pine_tree_at(World &world, Chunk &chunk, int x, int y) {
         // float unlikelinessOfHavingLeaves = hp;
         float unlikelinessOfHavingLeaves =
             unlikelinessOfHavingLeavesBasedOnRadius + hp;
-        float noise = world.tree_noise(cx, cy);
+        float noise = ctx.rng.next_float();
         auto needBlockHere = noise > unlikelinessOfHavingLeaves;
         if (needBlockHere) {
-          chunk_place_block(world, chunk, cx, cy, crownBottom,
+          chunk_place_block(ctx, cx, cy, crownBottom,
                             BlockType::PineTreeLeaves);
         }
       }
@@ -808,72 +790,129 @@ void build_pine_tree_at(World &world, Chunk &chunk, int x, int y) {
   }
   // stump
   for (; h < treeTopHeight; ++h) {
-    chunk_place_block(world, chunk, x, y, h, BlockType::PineWood);
+    chunk_place_block(ctx, x, y, h, BlockType::PineWood);
   }
 }
 
-optional<ChunkMetaMod const *> get_meta_stuff_for_chunk(World &world,
-                                                        Chunk &chunk) {
-  auto it = world.meta.find(chunk_id(chunk));
-  if (it == world.meta.end()) {
-    return {};
+template <TreeKind T>
+inline void build_tree(ChunkGenContext &ctx, int x, int y) {
+  if constexpr (T == TreeKind::Oak) {
+    build_oak_tree_at(ctx, x, y);
+  } else if constexpr (T == TreeKind::Jungle) {
+    build_jungle_tree(ctx, x, y);
+  } else if constexpr (T == TreeKind::Pine) {
+    build_pine_tree_at(ctx, x, y);
   }
-  return &it->second;
 }
 
-// Generates the height map and block types
-void gen_chunk(World &world, Chunk &chunk) {
+// Generates the height map and block types.
+//
+// The world is only read, so any number of chunks can be generated at once.
+// The chunk's own terrain and trees depend on nothing but the seed and the
+// chunk position; the structure blocks that neighbours have spilled into it
+// and the player edits are applied on top of them. Blocks that the chunk's
+// trees place into neighbours are not written anywhere but added to `spill`,
+// for the caller to hand to world_merge_chunk_spill.
+//
+// The blocks are left in `blocks`, chunk.blocks is not touched; the heights
+// of the columns are in chunk.heights.
+void gen_chunk_blocks(World const &world, Chunk &chunk,
+                      DenseChunkBlocks &blocks, ChunkSpill &spill) {
+  u64 samples_before = noise_sample_count;
+  gen_chunk_climate(world, chunk);
+  auto &climate = chunk.climate;
+
+  auto &heights = climate.terrain_height;
+  gen_chunk_heights(world, chunk, heights);
   for (int x = 0; x < CHUNK_WIDTH; ++x) {
-    int global_x = chunk.x + x;
     for (int y = 0; y < CHUNK_LENGTH; ++y) {
-      int global_y = chunk.y + y;
-      gen_column_at(world, &CHUNK_COL_AT(chunk, x, y), global_x, global_y);
+      gen_column_at(world, &CHUNK_COL_AT(blocks, x, y), climate.biome[x][y],
+                    heights[x][y]);
     }
   }
+  chunk_heightmap_build(chunk.heights, blocks);
 
   // generate trees
-  world.tree_gen_seed(chunk.x, chunk.y);
+  ChunkGenContext ctx{
+      .world = world,
+      .chunk = chunk,
+      .blocks = blocks,
+      .rng = ChunkRng(world.seed, chunk.x, chunk.y),
+      .spill = spill,
+  };
   for (int x = 0; x < CHUNK_WIDTH; ++x) {
-    int global_x = chunk.x + x;
     for (int y = 0; y < CHUNK_LENGTH; ++y) {
-      int global_y = chunk.y + y;
-      WorldPos pos{global_x, 0, global_y};
-      auto &biome = biome_at_point(world, global_x, global_y);
-      auto col = &CHUNK_COL_AT(chunk, x, y);
-      auto topBlockHeight = get_col_height(col);
-      if (!can_tree_grow_on(col[topBlockHeight].type)) {
+      auto kind = climate.biome[x][y];
+      auto topBlockHeight = chunk_heightmap_top_solid(chunk.heights, x, y);
+      if (!can_tree_grow_on(CHUNK_AT(blocks, x, y, topBlockHeight).type)) {
         continue;
       }
-      world.tree_noise(x, y);
-      float r = world.tree_noise(x, y);
-      auto has_tree_center_here = r < biome.treeFrequency;
-//      fmt::print("freq noise: {}, ({}), tree={}\n", r, biome.treeFrequency, has_tree_center_here);
+      float r = ctx.rng.next_float();
+      auto has_tree_center_here = r < world.biomes[kind].treeFrequency;
       if (has_tree_center_here) {
-        biome.treeGen(world, chunk, x, y);
+        with_biome(kind, [&](auto tag) {
+          build_tree<BIOME_TREES[decltype(tag)::value]>(ctx, x, y);
+        });
       }
     }
   }
 
-  // meta stuff
-  if (auto stuff = get_meta_stuff_for_chunk(world, chunk)) {
-    auto &modifList = **stuff;
-    for (auto &modif : modifList) {
-      auto &pos = modif.pos;
-      CHUNK_AT(chunk, pos.x, pos.y, pos.z).type = modif.block;
+  // structure blocks spilled in by the neighbours, kept to be saved with the
+  // chunk
+  chunk.spill_in = structure_store_incoming(world.structures, chunk_id(chunk));
+  for (auto &[source, mods] : chunk.spill_in) {
+    for (auto &mod : mods) {
+      CHUNK_AT(blocks, mod.x, mod.y, mod.z).type = mod.block;
+      chunk_heightmap_update(chunk.heights, blocks, mod.x, mod.y, mod.z,
+                             mod.block);
     }
   }
 
-  // apply changes last
-  // TODO: Do this locally
-  for (auto &atom : world.changes) {
-    auto pos = atom.pos;
-    auto ch = &chunk;
-    auto pos_inside = (pos.x > ch->x && pos.x < ch->x + CHUNK_WIDTH) &&
-                      (pos.y > ch->y && pos.y < ch->y + CHUNK_LENGTH);
-    if (!pos_inside) continue;
-    auto local_pos = chunk_global_to_local_pos(&chunk, pos);
-    CHUNK_AT(chunk, local_pos.x, local_pos.y, local_pos.z).type =
-        atom.block.type;
+  // apply the player edits last
+  edit_journal_for_chunk(world.edits, chunk_id(chunk),
+                         [&](BlockEdit const &edit) {
+                           CHUNK_AT(blocks, edit.x, edit.y, edit.z).type =
+                               edit.block;
+                           chunk_heightmap_update(chunk.heights, blocks,
+                                                  edit.x, edit.y, edit.z,
+                                                  edit.block);
+                         });
+
+  chunk.noise_samples = noise_sample_count - samples_before;
+}
+
+void gen_chunk(World const &world, Chunk &chunk, ChunkSpill &spill) {
+  auto &blocks = dense_blocks_scratch();
+  gen_chunk_blocks(world, chunk, blocks, spill);
+  chunk_blocks_pack(blocks, chunk.blocks);
+}
+
+// Records the structure blocks that the chunk at `source` places into its
+// neighbours. A loaded neighbour whose incoming blocks changed is marked stale
+// so it gets generated again with them; spill that is already known is
+// skipped, which keeps regenerating a chunk from bouncing between neighbours.
+void world_merge_chunk_spill(World &world, Chunk &source, ChunkSpill &spill) {
+  bool any_stale = false;
+  for (auto &[target, mods] : spill) {
+    if (!structure_store_merge(world.structures, chunk_id(source), target,
+                               mods)) {
+      continue;
+    }
+    // trees reach into the neighbours of their chunk, found without a lookup
+    int dx = (target.first - source.x) / CHUNK_WIDTH;
+    int dy = (target.second - source.y) / CHUNK_LENGTH;
+    Chunk *chunk = nullptr;
+    if (abs(dx) <= 1 && abs(dy) <= 1) chunk = chunk_neighbour(source, dx, dy);
+    if (chunk == nullptr) {
+      chunk = is_chunk_loaded(world, target.first, target.second);
+    }
+    if (chunk != nullptr) {
+      chunk->is_stale = true;
+      any_stale = true;
+    }
+  }
+  if (any_stale) {
+    chunk_scheduler_notify(world.scheduler, ChunkEvent::ChunksStale);
   }
 }
 
@@ -917,42 +956,31 @@ void occlusion(char neighbors[27], char lights[27], float shades[27],
   }
 }
 
-void load_chunk_at(World &world, int chunk_x, int chunk_y, Chunk &chunk) {
-  chunk.is_being_generated = true;
-  auto *mesh = new ChunkMesh();
-
-  // fmt::print("Loading chunk at {}, {}\n", chunk_x, chunk_y);
-  chunk.x = chunk_x;
-  chunk.y = chunk_y;
-  chunk.mesh = mesh;
-
-  // Determine the height map
-  gen_chunk(world, chunk);
-
-  // Generate the mesh
+// Appends the faces of the blocks of one vertical section of the chunk. The
+// bottom layer of the world is never meshed, and the columns are only walked
+// up to their top block.
+void gen_chunk_section_cubes(Chunk const &chunk, DenseChunkBlocks const &blocks,
+                             u32 section, ChunkQuads quads, ChunkMesh &mesh) {
+  int first_height = max(1, (int)section * CHUNK_SECTION_HEIGHT);
+  int last_height = ((int)section + 1) * CHUNK_SECTION_HEIGHT - 1;
+  if (first_height > chunk.heights.max_solid) return;
   for (int x = 0; x < CHUNK_WIDTH; ++x) {
-    int global_x = chunk.x + x;
-
     for (int y = 0; y < CHUNK_LENGTH; ++y) {
-      int global_y = chunk.y + y;
-      Block *bottomBlock = &CHUNK_COL_AT(chunk, x, y);
-      // start from the highest block
-      Block *column = &(bottomBlock[CHUNK_HEIGHT - 1]);
-
-      // skip the air blocks from above
-      while (column->type == BlockType::Air) column--;
+      Block const *bottomBlock = &CHUNK_COL_AT(blocks, x, y);
+      int top_height = min(last_height, (int)chunk.heights.solid[x][y]);
 
-      do {
-        Block block = *column;
-        int height = column - bottomBlock;
+      for (int height = top_height; height >= first_height; --height) {
+        Block block = bottomBlock[height];
+        // air has no faces
+        if (block.type == BlockType::Air) continue;
 
         // check which faces are exposed to a Transparent Block
-        int left = IS_TB_LEFT_OF(chunk, x, y, height);
-        int right = IS_TB_RIGHT_OF(chunk, x, y, height);
-        int front = IS_TB_FRONT_OF(chunk, x, y, height);
-        int back = IS_TB_BACK_OF(chunk, x, y, height);
-        int top = IS_TB_TOP_OF(chunk, x, y, height);
-        int bottom = IS_TB_BOTTOM_OF(chunk, x, y, height);
+        int left = IS_TB_LEFT_OF(blocks, x, y, height);
+        int right = IS_TB_RIGHT_OF(blocks, x, y, height);
+        int front = IS_TB_FRONT_OF(blocks, x, y, height);
+        int back = IS_TB_BACK_OF(blocks, x, y, height);
+        int top = IS_TB_TOP_OF(blocks, x, y, height);
+        int bottom = IS_TB_BOTTOM_OF(blocks, x, y, height);
 
         int wleft = 0;
         int wright = 0;
@@ -960,8 +988,6 @@ void load_chunk_at(World &world, int chunk_x, int chunk_y, Chunk &chunk) {
         int wbottom = 0;
         int wfront = 0;
         int wback = 0;
-        float n = 0.5;  // scaling
-
         float ao[6][4] = {0};
         float light[6][4] = {{0.5, 0.5, 0.5, 0.5}, {0.5, 0.5, 0.5, 0.5},
                              {0.5, 0.5, 0.5, 0.5}, {0.5, 0.5, 0.5, 0.5},
@@ -991,25 +1017,631 @@ void load_chunk_at(World &world, int chunk_x, int chunk_y, Chunk &chunk) {
         // }
         // occlusion(neighbors, lights, shades, ao, light);
 
-        make_cube_faces(*mesh, ao, light, left, right, top, bottom, front, back,
-                        wleft, wright, wtop, wbottom, wfront, wback,
-                        (float)global_x, (float)height, (float)global_y, n,
-                        block.type);
-        column--;
-      } while (column != bottomBlock);
+        make_cube_faces(mesh, quads, ao, light, left, right, top, bottom,
+                        front, back, wleft, wright, wtop, wbottom, wfront,
+                        wback, x, height, y, block.type);
+      }
+    }
+  }
+}
+
+// The type of the block at (x, y, height) when its face `i` is meshed by
+// gen_chunk_section_cubes, Air otherwise
+inline BlockType visible_face_type(Chunk const &chunk,
+                                   DenseChunkBlocks const &blocks, int i,
+                                   int x, int y, int height) {
+  if (height > chunk.heights.solid[x][y]) return BlockType::Air;
+  BlockType type = CHUNK_AT(blocks, x, y, height).type;
+  if (type == BlockType::Air) return type;
+  bool visible = false;
+  switch (i) {
+    case 0: visible = IS_TB_LEFT_OF(blocks, x, y, height); break;
+    case 1: visible = IS_TB_RIGHT_OF(blocks, x, y, height); break;
+    case 2: visible = IS_TB_TOP_OF(blocks, x, y, height); break;
+    case 3: visible = IS_TB_BOTTOM_OF(blocks, x, y, height); break;
+    case 4: visible = IS_TB_FRONT_OF(blocks, x, y, height); break;
+    case 5: visible = IS_TB_BACK_OF(blocks, x, y, height); break;
+  }
+  return visible ? type : BlockType::Air;
+}
+
+// Appends the faces `i` of a slice of blocks: `mask` holds the type of the
+// block of each face, Air where there is none, in `length` rows of `width`
+// along the v and u of the face from the block `first`. With `merge`, the
+// faces of the same block type are merged into rectangles: the mask is
+// walked row by row, a face starts a rectangle, which is widened along its
+// row while the faces match and then grown over the next rows while all of
+// their faces match. The faces all get the same ao and light, as the
+// occlusion pass is disabled, so the block type is all that has to match.
+// The mask is cleared.
+void make_mask_faces(ChunkMesh &mesh, ChunkQuads quads, int i,
+                     BlockType *mask, int width, int length, glm::ivec3 first,
+                     bool merge) {
+  int u_axis = cube_face_uv_axes[i][0];
+  int v_axis = cube_face_uv_axes[i][1];
+  float ao[4] = {0};
+  float light[4] = {0.5, 0.5, 0.5, 0.5};
+  glm::ivec3 pos = first;
+  for (int v = 0; v < length; ++v) {
+    for (int u = 0; u < width;) {
+      BlockType type = mask[v * width + u];
+      if (type == BlockType::Air) {
+        ++u;
+        continue;
+      }
+      int w = 1;
+      int h = 1;
+      if (merge) {
+        while (u + w < width && mask[v * width + u + w] == type) ++w;
+        for (; v + h < length; ++h) {
+          auto *row = mask + (v + h) * width;
+          if (std::any_of(row + u, row + u + w,
+                          [&](BlockType t) { return t != type; })) {
+            break;
+          }
+        }
+      }
+      for (int dv = 0; dv < h; ++dv) {
+        std::fill_n(mask + (v + dv) * width + u, w, BlockType::Air);
+      }
+
+      glm::ivec3 quad_size{1, 1, 1};
+      quad_size[u_axis] = w;
+      quad_size[v_axis] = h;
+      pos[u_axis] = first[u_axis] + u;
+      pos[v_axis] = first[v_axis] + v;
+      make_face(mesh, quads, i, ao, light, pos.x, pos.y, pos.z, quad_size,
+                type);
+      u += w;
+    }
+  }
+}
+
+// Appends the same faces as gen_chunk_section_cubes, with the coplanar faces
+// of the same block type merged into rectangles, slice by slice
+void gen_chunk_section_greedy(Chunk const &chunk,
+                              DenseChunkBlocks const &blocks, u32 section,
+                              ChunkQuads quads, ChunkMesh &mesh) {
+  int first_height = max(1, (int)section * CHUNK_SECTION_HEIGHT);
+  int last_height = min(((int)section + 1) * CHUNK_SECTION_HEIGHT - 1,
+                        (int)chunk.heights.max_solid);
+  if (first_height > last_height) return;
+  // the blocks of the section, along the axes of the faces: x, height, y
+  glm::ivec3 first{0, first_height, 0};
+  glm::ivec3 size{CHUNK_WIDTH, last_height - first_height + 1, CHUNK_LENGTH};
+  constexpr int MASK_SIDE =
+      max(CHUNK_SECTION_HEIGHT, max(CHUNK_WIDTH, CHUNK_LENGTH));
+  // the faces of the slice, by v then u
+  BlockType mask[MASK_SIDE * MASK_SIDE];
+  for (int i = 0; i < 6; ++i) {
+    int u_axis = cube_face_uv_axes[i][0];
+    int v_axis = cube_face_uv_axes[i][1];
+    int slice_axis = 3 - u_axis - v_axis;
+    int width = size[u_axis];
+    int length = size[v_axis];
+    for (int slice = 0; slice < size[slice_axis]; ++slice) {
+      glm::ivec3 slice_first = first;
+      slice_first[slice_axis] += slice;
+      glm::ivec3 pos = slice_first;
+      bool any = false;
+      for (int v = 0; v < length; ++v) {
+        pos[v_axis] = first[v_axis] + v;
+        for (int u = 0; u < width; ++u) {
+          pos[u_axis] = first[u_axis] + u;
+          auto &face = mask[v * width + u];
+          face = visible_face_type(chunk, blocks, i, pos.x, pos.z, pos.y);
+          any = any || face != BlockType::Air;
+        }
+      }
+      if (!any) continue;
+      make_mask_faces(mesh, quads, i, mask, width, length, slice_first, true);
+    }
+  }
+}
+
+// A column of the chunk, one bit per height, 64 heights per word
+constexpr int COLUMN_WORDS = CHUNK_HEIGHT / 64;
+static_assert(CHUNK_HEIGHT % 64 == 0 && 64 % CHUNK_SECTION_HEIGHT == 0,
+              "a section lies in one word of the column bits");
+using ColumnBits = std::array<u64, COLUMN_WORDS>;
+
+// The word `w` of the column, shifted so that each bit is the one of the
+// height above it. Nothing is above the top of the world.
+inline u64 column_word_above(ColumnBits const &bits, int w) {
+  u64 next = w + 1 < COLUMN_WORDS ? bits[w + 1] << 63 : 0;
+  return bits[w] >> 1 | next;
+}
+
+// Same with the height below
+inline u64 column_word_below(ColumnBits const &bits, int w) {
+  u64 previous = w > 0 ? bits[w - 1] >> 63 : 0;
+  return bits[w] << 1 | previous;
+}
+
+// Appends the same faces as gen_chunk_section_cubes, in the same order. The
+// blocks that are not air are turned into a bit per height of each column
+// first, so the faces of a whole column that show are found with a few
+// shifts and masks, instead of looking at the six neighbours of each block.
+void gen_chunk_section_binary(Chunk const &chunk,
+                              DenseChunkBlocks const &blocks, u32 section,
+                              ChunkQuads quads, ChunkMesh &mesh) {
+  int first_height = max(1, (int)section * CHUNK_SECTION_HEIGHT);
+  int last_height = ((int)section + 1) * CHUNK_SECTION_HEIGHT - 1;
+  if (first_height > chunk.heights.max_solid) return;
+  // the layers of the section, and the ones below and above it
+  ColumnBits solid[CHUNK_WIDTH][CHUNK_LENGTH];
+  for (int x = 0; x < CHUNK_WIDTH; ++x) {
+    for (int y = 0; y < CHUNK_LENGTH; ++y) {
+      auto &bits = solid[x][y];
+      bits = {};
+      Block const *column = &CHUNK_COL_AT(blocks, x, y);
+      int top = min(last_height + 1, (int)chunk.heights.solid[x][y]);
+      for (int height = first_height - 1; height <= top; ++height) {
+        bits[height / 64] |= (u64)(column[height].type != BlockType::Air)
+                             << (height % 64);
+      }
+    }
+  }
+  int word = first_height / 64;
+  float ao[4] = {0};
+  float light[4] = {0.5, 0.5, 0.5, 0.5};
+  for (int x = 0; x < CHUNK_WIDTH; ++x) {
+    for (int y = 0; y < CHUNK_LENGTH; ++y) {
+      int top = min(last_height, (int)chunk.heights.solid[x][y]);
+      if (top < first_height) continue;
+      auto &bits = solid[x][y];
+      u64 range = (~0ull >> (63 - top % 64)) & (~0ull << (first_height % 64));
+      u64 column = bits[word] & range;
+      // a face shows where the block next to it is air, the faces on the
+      // sides of the chunk are meshed by gen_chunk_side_mesh
+      u64 faces[6] = {
+          x > 0 ? column & ~solid[x - 1][y][word] : 0,
+          x < CHUNK_WIDTH - 1 ? column & ~solid[x + 1][y][word] : 0,
+          column & ~column_word_above(bits, word),
+          column & ~column_word_below(bits, word),
+          y > 0 ? column & ~solid[x][y - 1][word] : 0,
+          y < CHUNK_LENGTH - 1 ? column & ~solid[x][y + 1][word] : 0,
+      };
+      u64 shown = faces[0] | faces[1] | faces[2] | faces[3] | faces[4] |
+                  faces[5];
+      // from the top of the column down, like gen_chunk_section_cubes
+      while (shown != 0) {
+        int bit = 63 - std::countl_zero(shown);
+        shown &= ~(1ull << bit);
+        int height = word * 64 + bit;
+        BlockType type = CHUNK_AT(blocks, x, y, height).type;
+        for (int i = 0; i < 6; ++i) {
+          if ((faces[i] >> bit & 1) == 0) continue;
+          make_face(mesh, quads, i, ao, light, x, height, y, {1, 1, 1}, type);
+        }
+      }
+    }
+  }
+}
+
+void gen_chunk_section_mesh(Chunk const &chunk, DenseChunkBlocks const &blocks,
+                            u32 section, ChunkMeshing meshing,
+                            ChunkQuads quads, ChunkMesh &mesh) {
+  if (meshing == ChunkMeshing::Greedy) {
+    gen_chunk_section_greedy(chunk, blocks, section, quads, mesh);
+  } else if (meshing == ChunkMeshing::Binary) {
+    gen_chunk_section_binary(chunk, blocks, section, quads, mesh);
+  } else {
+    gen_chunk_section_cubes(chunk, blocks, section, quads, mesh);
+  }
+}
+
+// Appends the faces on the side of the chunk, the ones gen_chunk_section_mesh
+// leaves out. The faces next to a block of the neighbour in the halo are
+// hidden. They are merged section by section, the size of a quad fits in
+// its vertices up to the height of a section. Reads the packed blocks, so
+// the render thread can mesh the sides again without unpacking the chunk.
+void gen_chunk_side_mesh(Chunk const &chunk, ChunkHalo const &halo, u32 side,
+                         ChunkMeshing meshing, ChunkQuads quads,
+                         ChunkMesh &mesh) {
+  int width = chunk_side_width(side);
+  int top = 0;
+  for (int u = 0; u < width; ++u) {
+    auto block = chunk_side_block(side, u, 0);
+    top = max<int>(top, chunk.heights.solid[block.x][block.z]);
+  }
+  BlockType mask[CHUNK_SECTION_HEIGHT * CHUNK_SIDE_BLOCKS];
+  // the bottom layer of the world is never meshed
+  for (int first = 1; first <= top;
+       first = (first / CHUNK_SECTION_HEIGHT + 1) * CHUNK_SECTION_HEIGHT) {
+    int last = min(top, (first / CHUNK_SECTION_HEIGHT + 1) *
+                            CHUNK_SECTION_HEIGHT - 1);
+    for (int height = first; height <= last; ++height) {
+      for (int u = 0; u < width; ++u) {
+        auto block = chunk_side_block(side, u, height);
+        BlockType type = BlockType::Air;
+        if (height <= chunk.heights.solid[block.x][block.z] &&
+            !halo.solid[side][u][height]) {
+          type = chunk_blocks_get(chunk.blocks, block.x, block.z, height).type;
+        }
+        mask[(height - first) * width + u] = type;
+      }
+    }
+    make_mask_faces(mesh, quads, chunk_side_faces[side], mask, width,
+                    last - first + 1, chunk_side_block(side, 0, first),
+                    meshing == ChunkMeshing::Greedy);
+  }
+}
+
+void chunk_halo_copy(Chunk const &chunk, ChunkHalo &halo) {
+  for (u32 side = 0; side < CHUNK_SIDES; ++side) {
+    halo.versions[side] = 0;
+    halo.busy[side] = false;
+    for (auto &column : halo.solid[side]) column.reset();
+    auto &step = chunk_side_steps[side];
+    auto *neighbour = chunk_neighbour(chunk, step[0], step[1]);
+    if (neighbour == nullptr) continue;
+    // never waits, so a thread holds the blocks of one chunk at a time. The
+    // side is meshed again by remesh_chunk_sides_at once the neighbour is free.
+    std::unique_lock<std::mutex> lock(neighbour->blocks_mutex,
+                                      std::try_to_lock);
+    if (!lock.owns_lock()) {
+      halo.busy[side] = true;
+      continue;
+    }
+    if (neighbour->is_being_generated) continue;
+    halo.versions[side] = neighbour->blocks_version;
+    // the side of the neighbour that faces this one
+    u32 facing = side ^ 1;
+    for (int u = 0; u < chunk_side_width(side); ++u) {
+      auto block = chunk_side_block(facing, u, 0);
+      int top = neighbour->heights.solid[block.x][block.z];
+      for (int height = 0; height <= top; ++height) {
+        auto type =
+            chunk_blocks_get(neighbour->blocks, block.x, block.z, height).type;
+        if (type != BlockType::Air) halo.solid[side][u].set(height);
+      }
+    }
+  }
+}
+
+// Builds the mesh of the chunk's blocks, section by section and then side by
+// side
+void gen_chunk_mesh(Chunk &chunk, DenseChunkBlocks const &blocks,
+                    ChunkHalo const &halo, ChunkMeshing meshing,
+                    ChunkQuads quads, ChunkMesh &mesh) {
+  for (u32 section = 0; section < CHUNK_SECTIONS; ++section) {
+    chunk.mesh_sections[section] = mesh.size();
+    gen_chunk_section_mesh(chunk, blocks, section, meshing, quads, mesh);
+  }
+  for (u32 side = 0; side < CHUNK_SIDES; ++side) {
+    chunk.mesh_sections[CHUNK_SECTIONS + side] = mesh.size();
+    gen_chunk_side_mesh(chunk, halo, side, meshing, quads, mesh);
+  }
+  chunk.mesh_sections[CHUNK_MESH_PARTS] = mesh.size();
+  chunk.side_versions = halo.versions;
+}
+
+void gen_chunk_mesh(Chunk &chunk, ChunkMeshing meshing, ChunkQuads quads,
+                    ChunkMesh &mesh) {
+  ChunkHalo halo;
+  chunk_halo_copy(chunk, halo);
+  auto &blocks = dense_blocks_scratch();
+  chunk_blocks_unpack(chunk.blocks, blocks);
+  gen_chunk_mesh(chunk, blocks, halo, meshing, quads, mesh);
+}
+
+u64 chunk_mesh_block_faces(ChunkMesh const &mesh, ChunkQuads quads) {
+  u64 faces = 0;
+  size_t n = chunk_quad_vertices(quads);
+  // the far corner of a quad has the number of blocks it spans as its tile
+  for (size_t quad = 0; quad + n <= mesh.size(); quad += n) {
+    u64 width = 0;
+    u64 length = 0;
+    for (size_t v = quad; v < quad + n; ++v) {
+      width = max<u64>(width, vertex_tile_u(mesh[v]));
+      length = max<u64>(length, vertex_tile_v(mesh[v]));
+    }
+    faces += width * length;
+  }
+  return faces;
+}
+
+// version of the chunk payloads in the region files
+constexpr u8 CHUNK_SAVE_VERSION = 1;
+// the chunk was saved out of date, it is generated again when loaded
+constexpr u8 CHUNK_SAVE_STALE = 1 << 0;
+
+template <typename Spill>
+void write_saved_spill(vector<u8> &out, Spill const &spill) {
+  byte_write(out, (u32)spill.size());
+  for (auto &[id, mods] : spill) {
+    byte_write(out, id.first);
+    byte_write(out, id.second);
+    byte_write(out, (u32)mods.size());
+    byte_write_bytes(out, mods.data(), mods.size() * sizeof(Mod));
+  }
+}
+
+template <typename Spill>
+void read_saved_spill(ByteReader &in, Spill &spill) {
+  u32 count = byte_read<u32>(in);
+  for (u32 i = 0; i < count && !in.failed; ++i) {
+    ChunkId id;
+    id.first = byte_read<i32>(in);
+    id.second = byte_read<i32>(in);
+    u32 nmods = byte_read<u32>(in);
+    if (nmods > (size_t)(in.end - in.at) / sizeof(Mod)) {
+      in.failed = true;
+      return;
+    }
+    auto &mods = spill[id];
+    mods.resize(nmods);
+    byte_read_bytes(in, mods.data(), nmods * sizeof(Mod));
+  }
+}
+
+// The payload of a chunk in its region file: the packed blocks, the biomes
+// and terrain heights of the columns, the structure blocks spilled into and
+// by the chunk, and the player edits. The climate noise is not saved, only
+// the map export reads it.
+void write_saved_chunk(World &world, Chunk &chunk, vector<u8> &out) {
+  byte_write(out, CHUNK_SAVE_VERSION);
+  byte_write(out, (u8)(chunk.is_stale ? CHUNK_SAVE_STALE : 0));
+  byte_write_bytes(out, chunk.climate.biome, sizeof(chunk.climate.biome));
+  byte_write_bytes(out, chunk.climate.terrain_height,
+                   sizeof(chunk.climate.terrain_height));
+  chunk_blocks_write(chunk.blocks, out);
+  write_saved_spill(out, chunk.spill_in);
+  write_saved_spill(out, chunk.spill_out);
+  vector<BlockEdit> edits;
+  edit_journal_for_chunk(world.edits, chunk_id(chunk),
+                         [&](BlockEdit const &edit) { edits.push_back(edit); });
+  byte_write(out, (u32)edits.size());
+  byte_write_bytes(out, edits.data(), edits.size() * sizeof(BlockEdit));
+}
+
+// Reads the chunk back from its region file into chunk.blocks and `blocks`,
+// and the structure blocks it spills into `spill`. False when it was never
+// saved or has to be generated again: it was saved out of date, or a
+// neighbour spilled blocks into it since. Its edits and the blocks spilled
+// into it are restored either way, for the generation to apply them.
+bool load_saved_chunk(World &world, Chunk &chunk, DenseChunkBlocks &blocks,
+                      ChunkSpill &spill) {
+  thread_local vector<u8> data;
+  auto id = chunk_id(chunk);
+  if (!region_store_read(world.saves, id, data)) return false;
+  ByteReader in{data.data(), data.data() + data.size()};
+  if (byte_read<u8>(in) != CHUNK_SAVE_VERSION) return false;
+  u8 flags = byte_read<u8>(in);
+  byte_read_bytes(in, chunk.climate.biome, sizeof(chunk.climate.biome));
+  byte_read_bytes(in, chunk.climate.terrain_height,
+                  sizeof(chunk.climate.terrain_height));
+  bool blocks_ok = chunk_blocks_read(in, chunk.blocks);
+  IncomingMods incoming;
+  read_saved_spill(in, incoming);
+  read_saved_spill(in, spill);
+  u32 nedits = byte_read<u32>(in);
+  vector<BlockEdit> edits;
+  if (nedits <= (size_t)(in.end - in.at) / sizeof(BlockEdit)) {
+    edits.resize(nedits);
+    byte_read_bytes(in, edits.data(), nedits * sizeof(BlockEdit));
+  }
+  if (!blocks_ok || in.failed || edits.size() != nedits || in.at != in.end) {
+    logger::error(fmt::format("The saved chunk at {}, {} is damaged, ignored",
+                              chunk.x, chunk.y));
+    spill.clear();
+    return false;
+  }
+
+  edit_journal_restore(world.edits, id, edits);
+  for (auto &[source, mods] : incoming) {
+    auto copy = mods;
+    structure_store_merge(world.structures, source, id, copy);
+  }
+  if ((flags & CHUNK_SAVE_STALE) ||
+      structure_store_incoming(world.structures, id).size() !=
+          incoming.size()) {
+    spill.clear();
+    return false;
+  }
+  chunk.spill_in = std::move(incoming);
+  chunk_blocks_unpack(chunk.blocks, blocks);
+  // the edit log may hold edits made after the chunk was saved
+  edit_journal_for_chunk(world.edits, id, [&](BlockEdit const &edit) {
+    auto &block = CHUNK_AT(blocks, edit.x, edit.y, edit.z);
+    if (block.type == edit.block) return;
+    block.type = edit.block;
+    chunk_blocks_set(chunk.blocks, edit.x, edit.y, edit.z, edit.block);
+    chunk.is_unsaved = true;
+  });
+  chunk_heightmap_build(chunk.heights, blocks);
+  chunk.noise_samples = 0;
+  return true;
+}
+
+// Loads the chunk from its region file when it was saved, or generates it,
+// and meshes it. Chunks that are stale are always generated again.
+void load_chunk_at(World &world, Chunk &chunk) {
+  bool first_load = chunk.is_being_generated.exchange(true);
+  auto *mesh = new ChunkMesh();
+
+  // fmt::print("Loading chunk at {}, {}\n", chunk.x, chunk.y);
+  chunk.mesh = mesh;
+
+  // Determine the height map
+  chunk.is_stale = false;
+  chunk.is_mesh_stale = false;
+  ChunkSpill spill;
+  bool loaded = false;
+  // before the chunk's own blocks are locked, see chunk_halo_copy
+  ChunkHalo halo;
+  chunk_halo_copy(chunk, halo);
+  {
+    std::lock_guard<std::mutex> guard(chunk.blocks_mutex);
+    auto &blocks = dense_blocks_scratch();
+    loaded = first_load && load_saved_chunk(world, chunk, blocks, spill);
+    if (!loaded) {
+      gen_chunk_blocks(world, chunk, blocks, spill);
+      chunk_blocks_pack(blocks, chunk.blocks);
     }
+    chunk.spill_out = spill;
+    chunk.blocks_version = ++world.last_blocks_version;
+    gen_chunk_mesh(chunk, blocks, halo, world.meshing, world.quads, *mesh);
+  }
+  world.meshed_vertices += mesh->size();
+  world.meshed_faces += chunk_mesh_block_faces(*mesh, world.quads);
+  world_merge_chunk_spill(world, chunk, spill);
+  if (loaded) {
+    world.chunks_loaded++;
+  } else {
+    world.noise_samples += chunk.noise_samples;
+    world.chunks_generated++;
+    chunk.is_unsaved = true;
   }
 
   chunk.is_dirty = true;
   chunk.is_being_generated = false;
 }
 
+void remesh_chunk_at(World &world, Chunk &chunk) {
+  auto *mesh = new ChunkMesh();
+  ChunkHalo halo;
+  chunk_halo_copy(chunk, halo);
+  {
+    std::lock_guard<std::mutex> guard(chunk.blocks_mutex);
+    chunk.is_mesh_stale = false;
+    auto &blocks = dense_blocks_scratch();
+    chunk_blocks_unpack(chunk.blocks, blocks);
+    gen_chunk_mesh(chunk, blocks, halo, world.meshing, world.quads, *mesh);
+  }
+  world.meshed_vertices += mesh->size();
+  world.meshed_faces += chunk_mesh_block_faces(*mesh, world.quads);
+  // no mesh is waiting to be uploaded, see world_remesh_chunks
+  chunk.mesh = mesh;
+  chunk.is_dirty = true;
+}
+
+void world_remesh_chunks(World &world) {
+  for_all_chunks_in_rd(world, [&](Chunk &chunk) {
+    // built with the old settings, the chunk keeps drawing its uploaded mesh
+    // until the new one is built
+    if (chunk.is_dirty) {
+      delete chunk.mesh;
+      chunk.mesh = nullptr;
+      chunk.is_dirty = false;
+    }
+    chunk.mesh_patch.reset();
+    chunk.is_mesh_stale = true;
+  });
+  chunk_scheduler_notify(world.scheduler, ChunkEvent::MeshingChanged);
+}
+
+void world_open_saves(World &world, const string &dir) {
+  // the chunks of another seed or blending would not match their neighbours
+  auto blending =
+      world.height_blending == HeightBlending::Lattice ? "lattice" : "exact";
+  auto name = fmt::format("{}-{}", world.seed, blending);
+  string saves_dir;
+  if (!dir.empty()) saves_dir = fmt::format("{}/{}", dir, name);
+  if (saves_dir == world.saves.dir && name == world.edits_world) return;
+  // the edits of the other world are in its log, or were not saved
+  edit_log_close(world.edit_log);
+  edit_journal_clear(world.edits);
+  world.edits_world = name;
+  region_store_open(world.saves, saves_dir);
+  if (world.saves.dir.empty()) return;
+  edit_log_open(world.edit_log, world.saves.dir + "/edits.log", world.edits);
+}
+
+void world_save_chunk(World &world, Chunk &chunk) {
+  // never generated, or not changed since it was saved or loaded
+  if (world.saves.dir.empty() || chunk.is_being_generated ||
+      !chunk.is_unsaved) {
+    return;
+  }
+  vector<u8> data;
+  write_saved_chunk(world, chunk, data);
+  region_store_write(world.saves, chunk_id(chunk), std::move(data));
+  chunk.is_unsaved = false;
+}
+
+void world_save_chunks(World &world) {
+  std::lock_guard<std::mutex> loaded_guard(world.loaded_chunks_mutex);
+  chunk_map_for_each(world.loaded_chunks, [&](ChunkId, Chunk *chunk) {
+    world_save_chunk(world, *chunk);
+  });
+  for (auto *chunk : world.chunks_to_free) world_save_chunk(world, *chunk);
+}
+
 void unload_chunk(Chunk *chunk) {
 //  fmt::print("Unloading chunk at {}, {}\n", chunk->x, chunk->y);
+#ifndef HEADLESS
 #ifdef VAO_ALLOCATION
   fmt::print("Deallocating VAO={}\n", chunk->vao);
 #endif
   glDeleteVertexArrays(1, &chunk->vao);
+  glDeleteBuffers(1, &chunk->buffer);
+#endif
+}
+
+// Unloads the chunks that left the render distance and recycles their
+// storage. Runs on the render thread, which owns the GL buffers. A chunk that
+// came back into the radius before it got here is kept, and one that still
+// has a generation job is freed once the job is done or cancelled, and the
+// other jobs that started before it was unloaded are done too.
+void free_unloaded_chunks(World &world) {
+  // no loading pass may pick a chunk up while it is being unloaded, try again
+  // on the next frame when one is running
+  std::unique_lock<std::mutex> load_lock(world.load_mutex, std::try_to_lock);
+  if (!load_lock.owns_lock()) return;
+  {
+    std::lock_guard<std::mutex> guard(world.chunk_unload_mutex);
+    if (!world.chunks_to_unload.empty()) {
+      std::unordered_set<Chunk *> in_radius;
+      {
+        std::lock_guard<std::mutex> chunks_guard(world.chunks_mutex);
+        in_radius.insert(world.grid.cells.begin(), world.grid.cells.end());
+      }
+      std::lock_guard<std::mutex> loaded_guard(world.loaded_chunks_mutex);
+      for (auto &[key, chunkp] : world.chunks_to_unload) {
+        if (in_radius.count(chunkp)) continue;
+        unload_chunk(chunkp);
+        chunk_map_erase(world.loaded_chunks, key);
+        // it left the grid, so no job that starts from now on can find it
+        chunkp->unloaded_after_job = world.gen_pool.jobs_started;
+        world.chunks_to_free.push_back(chunkp);
+      }
+      world.chunks_to_unload.clear();
+    }
+  }
+  // the lookups of the loading pass and of the workers are the only ones off
+  // this thread
+  if (world.loaded_chunks.tables.size() > 1 && world.gen_pool.running == 0) {
+    std::lock_guard<std::mutex> loaded_guard(world.loaded_chunks_mutex);
+    chunk_map_reclaim(world.loaded_chunks);
+  }
+
+  auto &to_free = world.chunks_to_free;
+  auto kept = to_free.begin();
+  for (auto *chunk : to_free) {
+    if (chunk->is_queued ||
+        !chunk_pool_finished_up_to(world.gen_pool,
+                                   chunk->unloaded_after_job)) {
+      *kept++ = chunk;
+    } else {
+      world_save_chunk(world, *chunk);
+      // the blocks spilled into a saved chunk are loaded back with it
+      if (!chunk->is_unsaved && !chunk->is_stale) {
+        structure_store_drop(world.structures, chunk_id(*chunk),
+                             chunk->spill_in);
+      }
+      chunk_slab_release(world.chunk_slabs, chunk);
+    }
+  }
+  to_free.erase(kept, to_free.end());
+
+  // return the memory after the render distance went down. No worker holds
+  // a released chunk anymore.
+  auto &slabs = world.chunk_slabs;
+  if (slabs.free_chunks > slabs.live + CHUNK_SLAB_CHUNKS) {
+    chunk_slab_trim(slabs);
+  }
 }
 
 // distance from one chunk to another, in chunks
@@ -1028,52 +1660,187 @@ inline u32 distance_to_chunk(WorldPos pos, Chunk *chunk) {
 
 void unload_distant_chunks(World &world, WorldPos center_pos, u32 radius) {
   std::lock_guard<std::mutex> guard(world.chunk_unload_mutex);
+  std::lock_guard<std::mutex> loaded_guard(world.loaded_chunks_mutex);
   int center_x = center_pos.x;
   int center_y = center_pos.z;
+  int first_chunk_x = round_to_nearest_16(center_x) - (CHUNK_WIDTH * radius);
+  int first_chunk_y = round_to_nearest_16(center_y) - (CHUNK_LENGTH * radius);
+  int last_chunk_x = first_chunk_x + CHUNK_WIDTH * radius * 2;
+  int last_chunk_y = first_chunk_y + CHUNK_LENGTH * radius * 2;
 
-  for (auto it = world.loaded_chunks.begin(); it != world.loaded_chunks.end();
-       ++it) {
-    auto chunkp = it->second;
-
+  chunk_map_for_each(world.loaded_chunks, [&](ChunkId id, Chunk *chunkp) {
     if (chunkp == nullptr) {
-      continue;
+      return;
     }
 
-    int first_chunk_x = round_to_nearest_16(center_x) - (CHUNK_WIDTH * radius);
-    int first_chunk_y = round_to_nearest_16(center_y) - (CHUNK_LENGTH * radius);
-    int last_chunk_x = first_chunk_x + CHUNK_WIDTH * radius * 2;
-    int last_chunk_y = first_chunk_y + CHUNK_LENGTH * radius * 2;
     bool in_radius = chunkp->x >= first_chunk_x && chunkp->x <= last_chunk_x &&
                      chunkp->y >= first_chunk_y && chunkp->y <= last_chunk_y;
 
     if (!in_radius) {
       bool is_scheduled_to_unload = false;
       for (auto &[key, chunk] : world.chunks_to_unload) {
-        if (key == it->first) {
+        if (key == id) {
           is_scheduled_to_unload = true;
           break;
         }
       }
-      if (is_scheduled_to_unload) continue;  // already scheduled, skip
-      world.chunks_to_unload.push_back(make_pair(it->first, chunkp));
+      if (is_scheduled_to_unload) return;  // already scheduled, skip
+      world.chunks_to_unload.push_back(make_pair(id, chunkp));
+    }
+  });
+
+  // the chunks left behind are generated again when the player comes back,
+  // with their neighbours, so their pending structure blocks are not needed
+  structure_store_retain(world.structures, first_chunk_x, first_chunk_y,
+                         last_chunk_x, last_chunk_y);
+}
+
+// Meshes the parts of the chunk's mesh in `parts` again into
+// `chunk.mesh_patch`, next to the parts patched since the last frame. The new
+// vertices are left there for the render thread, which copies them into the
+// uploaded mesh on the next frame. The blocks of the chunk are locked.
+void chunk_patch_mesh(Chunk &chunk, ChunkHalo const &halo,
+                      std::bitset<CHUNK_MESH_PARTS> parts,
+                      ChunkMeshing meshing, ChunkQuads quads) {
+  if (!chunk.mesh_patch) chunk.mesh_patch = make_unique<ChunkMeshPatch>();
+  auto &patch = *chunk.mesh_patch;
+
+  DenseChunkBlocks *blocks = nullptr;
+  for (u32 part = 0; part < CHUNK_MESH_PARTS; ++part) {
+    if (!parts[part]) continue;
+    auto &mesh = patch.meshes[part];
+    mesh.clear();
+    if (part < CHUNK_SECTIONS) {
+      if (blocks == nullptr) {
+        blocks = &dense_blocks_scratch();
+        chunk_blocks_unpack(chunk.blocks, *blocks);
+      }
+      gen_chunk_section_mesh(chunk, *blocks, part, meshing, quads, mesh);
+      continue;
+    }
+    u32 side = part - CHUNK_SECTIONS;
+    gen_chunk_side_mesh(chunk, halo, side, meshing, quads, mesh);
+    chunk.side_versions[side] = halo.versions[side];
+  }
+  patch.parts |= parts;
+}
+
+// Whether the mesh of the chunk can be patched: it is uploaded and no worker
+// is about to replace it
+inline bool chunk_mesh_patchable(Chunk const &chunk) {
+  return !chunk.is_being_generated && !chunk.is_queued && !chunk.is_dirty &&
+         chunk.mesh_size != 0;
+}
+
+// Writes the block into the chunk and remeshes the parts of the mesh whose
+// faces it changes: its section, the one above or below when it is at the
+// edge of its section, and the sides of the chunk it is on, which come after
+// all the sections. Returns false when the chunk is being generated or its
+// mesh is not uploaded yet; the edit is then applied by generating the chunk
+// again.
+bool chunk_edit_in_place(Chunk &chunk, ChunkHalo const &halo,
+                         WorldPos local_pos, BlockType type,
+                         ChunkMeshing meshing, ChunkQuads quads) {
+  if (!chunk_mesh_patchable(chunk)) return false;
+  std::unique_lock<std::mutex> lock(chunk.blocks_mutex, std::try_to_lock);
+  if (!lock.owns_lock()) return false;
+
+  chunk_blocks_set(chunk.blocks, local_pos.x, local_pos.y, local_pos.z, type);
+  chunk_heightmap_update(chunk.heights, chunk.blocks, local_pos.x, local_pos.y,
+                         local_pos.z, type);
+  std::bitset<CHUNK_MESH_PARTS> parts;
+  u32 section = local_pos.z / CHUNK_SECTION_HEIGHT;
+  parts.set(section);
+  // the top face of the block below and the bottom face of the block above
+  if (local_pos.z % CHUNK_SECTION_HEIGHT == 0 && section > 0) {
+    parts.set(section - 1);
+  }
+  if (local_pos.z % CHUNK_SECTION_HEIGHT == CHUNK_SECTION_HEIGHT - 1 &&
+      section + 1 < CHUNK_SECTIONS) {
+    parts.set(section + 1);
+  }
+  for (u32 side = 0; side < CHUNK_SIDES; ++side) {
+    int u = chunk_side_steps[side][0] != 0 ? local_pos.y : local_pos.x;
+    auto block = chunk_side_block(side, u, 0);
+    if (block.x == local_pos.x && block.z == local_pos.y) {
+      parts.set(CHUNK_SECTIONS + side);
     }
   }
+  chunk_patch_mesh(chunk, halo, parts, meshing, quads);
+  return true;
+}
+
+// The sides of the chunk whose neighbour arrived, left or changed since they
+// were meshed, as parts of its mesh
+std::bitset<CHUNK_MESH_PARTS> chunk_stale_sides(Chunk const &chunk) {
+  std::bitset<CHUNK_MESH_PARTS> parts;
+  for (u32 side = 0; side < CHUNK_SIDES; ++side) {
+    auto &step = chunk_side_steps[side];
+    auto *neighbour = chunk_neighbour(chunk, step[0], step[1]);
+    // compared once it is generated
+    if (neighbour != nullptr && neighbour->is_being_generated) continue;
+    u32 version = neighbour != nullptr ? neighbour->blocks_version.load() : 0;
+    if (version == chunk.side_versions[side]) continue;
+    parts.set(CHUNK_SECTIONS + side);
+  }
+  return parts;
+}
+
+void remesh_chunk_sides_at(World &world, Chunk &chunk) {
+  auto parts = chunk_stale_sides(chunk);
+  ChunkHalo halo;
+  chunk_halo_copy(chunk, halo);
+  // the sides keep their faces until their neighbours are free, meshing them
+  // without the neighbour's blocks would only have them meshed again. They
+  // are still stale, so the chunk is queued again on a later frame.
+  for (u32 side = 0; side < CHUNK_SIDES; ++side) {
+    if (halo.busy[side]) parts.reset(CHUNK_SECTIONS + side);
+  }
+  if (parts.none()) return;
+  std::lock_guard<std::mutex> guard(chunk.blocks_mutex);
+  chunk_patch_mesh(chunk, halo, parts, world.meshing, world.quads);
 }
 
 void chunk_modify_block_at_global(World &world, Chunk *chunk, WorldPos pos,
                                   BlockType type) {
   fmt::print("Modified block at {},{},{}\n", pos.x, pos.y, pos.z);
-  world.changes.push_back({.pos = pos, .block = {.type = type}});
-  // auto local_pos = chunk_global_to_local_pos(chunk, pos);
-  // Block b;
-  // b.type = type;
-  // chunk->blocks[local_pos.x][local_pos.y][local_pos.z] = b;
-  chunk->is_dirty = true;
+  if (pos.z < 0 || pos.z >= CHUNK_HEIGHT) return;
+  auto id = chunk_pos_for_coords(pos);
+  BlockEdit edit{
+      .x = (u8)(pos.x - id.first),
+      .y = (u8)(pos.y - id.second),
+      .z = (u8)pos.z,
+      .block = type,
+  };
+  // in the journal before the log, which is compacted from the journal
+  edit_journal_record(world.edits, id, edit);
+  edit_log_append(world.edit_log, id, edit);
+  chunk->is_unsaved = true;
+  auto local_pos = chunk_global_to_local_pos(chunk, pos);
+  // before the chunk's own blocks are locked, see chunk_halo_copy
+  ChunkHalo halo;
+  chunk_halo_copy(*chunk, halo);
+  if (chunk_edit_in_place(*chunk, halo, local_pos, type, world.meshing,
+                          world.quads)) {
+    // the neighbours mesh the side facing the block again
+    if (local_pos.x == 0 || local_pos.x == CHUNK_WIDTH - 1 ||
+        local_pos.y == 0 || local_pos.y == CHUNK_LENGTH - 1) {
+      chunk->blocks_version = ++world.last_blocks_version;
+    }
+    return;
+  }
+  chunk->is_stale = true;
+  chunk_scheduler_notify(world.scheduler, ChunkEvent::BlockEdited);
 }
 
 optional<Block> get_block_at_global_pos(World &world, WorldPos pos) {
+  if (pos.z < 0 || pos.z >= CHUNK_HEIGHT) return {};
   auto *chunk = find_chunk_with_pos(world, pos);
   if (chunk == nullptr) return {};
+  // the packed blocks are rebuilt while the chunk is generated again, the
+  // render thread does not wait for it
+  std::unique_lock<std::mutex> lock(chunk->blocks_mutex, std::try_to_lock);
+  if (!lock.owns_lock() || chunk->is_being_generated) return {};
   return chunk_get_block_at_global(chunk, pos);
 }
 
@@ -1101,8 +1868,41 @@ inline bool can_place_at_block(BlockType type) {
   }
 }
 
+// How much longer a chunk behind the player waits than one at the same
+// distance in front of them
+constexpr float CHUNK_BEHIND_PENALTY = 1.0f;
+
+// Order in which the missing chunks are generated: by distance to the player,
+// chunks in the view direction first
+inline float chunk_gen_priority(int chunk_x, int chunk_y, int center_x,
+                                int center_y, vec2 view) {
+  vec2 d{(float)(chunk_x + CHUNK_WIDTH / 2 - center_x) / CHUNK_WIDTH,
+         (float)(chunk_y + CHUNK_LENGTH / 2 - center_y) / CHUNK_LENGTH};
+  float distance = glm::length(d);
+  if (distance < 1.0f) return distance;
+  float facing = glm::dot(d / distance, view);
+  return distance * (1.0f + CHUNK_BEHIND_PENALTY * (1.0f - facing) * 0.5f);
+}
+
+void gen_chunk_job(World &world, ChunkJob &job) {
+  auto &chunk = *job.chunk;
+  if (chunk.is_being_generated || chunk.is_stale) {
+    load_chunk_at(world, chunk);
+  } else if (chunk.is_mesh_stale) {
+    remesh_chunk_at(world, chunk);
+  } else {
+    remesh_chunk_sides_at(world, chunk);
+  }
+  chunk.is_queued = false;
+}
+
+// Moves the render distance grid with the player, creating the chunks that
+// came into it, and queues its chunks that are missing or stale on the
+// generation pool. The queue is rebuilt on every pass, so the priorities
+// follow the player and chunks that left the radius are dropped.
 void load_chunks_around_player(World &world, WorldPos center_pos,
-                               uint32_t radius) {
+                               uint32_t radius, vec3 view_dir) {
+  std::lock_guard<std::mutex> guard(world.load_mutex);
   int center_x = center_pos.x;
   int center_y = center_pos.z;
   int first_chunk_x = round_to_nearest_16(center_x) - (CHUNK_WIDTH * radius);
@@ -1110,34 +1910,98 @@ void load_chunks_around_player(World &world, WorldPos center_pos,
 
   int chunk_cols = radius * 2;
   int chunk_rows = radius * 2;
-  int chunk_idx = 0;
-
-  auto it = world.chunks.begin();
-
-  for (int chunk_row = 0; chunk_row < chunk_rows; ++chunk_row) {
-    int chunk_y = first_chunk_y + chunk_row * CHUNK_LENGTH;
-    for (int chunk_col = 0; chunk_col < chunk_cols; ++chunk_col) {
-      int chunk_x = first_chunk_x + chunk_col * CHUNK_WIDTH;
-      auto loaded_ch = is_chunk_loaded(world, chunk_x, chunk_y);
-      bool loaded = loaded_ch != nullptr;
-
-      if (!loaded) {
-        loaded_ch = new Chunk();
-        load_chunk_at(world, chunk_x, chunk_y, *loaded_ch);
-        world.loaded_chunks.insert(
-            {chunk_id_from_coords(chunk_x, chunk_y), loaded_ch});
-      } else if (loaded_ch->is_dirty) {
-        logger::debug("Chunk is dirty, reloading mesh...");
-        load_chunk_at(world, chunk_x, chunk_y, *loaded_ch);
-      } else {
-        // no need to regenerate
-      }
+  // the render distance changed since this pass was requested, the next
+  // one has the new radius
+  if (world.grid.side != chunk_cols) return;
+
+  auto &pool = world.gen_pool;
+  if (pool.workers.empty()) {
+    chunk_pool_start(
+        pool, chunk_pool_default_size(),
+        [&world](ChunkJob &job) { gen_chunk_job(world, job); },
+        [](ChunkJob &job) { job.chunk->is_queued = false; });
+  }
+  chunk_pool_set_region(pool, first_chunk_x, first_chunk_y,
+                        first_chunk_x + (chunk_cols - 1) * CHUNK_WIDTH,
+                        first_chunk_y + (chunk_rows - 1) * CHUNK_LENGTH);
+  chunk_pool_clear(pool);
 
-      world.chunks[chunk_idx] = loaded_ch;
+  // the chunks that came into the render distance, the others keep their cell
+  {
+    std::lock_guard<std::mutex> chunks_guard(world.chunks_mutex);
+    chunk_grid_move(world.grid, first_chunk_x, first_chunk_y,
+                    [&](i32 chunk_x, i32 chunk_y) {
+                      // it may not have been unloaded yet
+                      auto *chunk = is_chunk_loaded(world, chunk_x, chunk_y);
+                      if (chunk != nullptr) return chunk;
+                      chunk = chunk_slab_acquire(world.chunk_slabs);
+                      chunk->x = chunk_x;
+                      chunk->y = chunk_y;
+                      chunk->entered_radius = ChunkClock::now();
+                      chunk->latency_pending = true;
+                      std::lock_guard<std::mutex> loaded_guard(
+                          world.loaded_chunks_mutex);
+                      chunk_map_insert(world.loaded_chunks,
+                                       chunk_id_from_coords(chunk_x, chunk_y),
+                                       chunk);
+                      return chunk;
+                    });
+  }
 
-      ++chunk_idx;
+  // the camera looks along (x, height, y)
+  vec2 view{view_dir.x, view_dir.z};
+  if (glm::length(view) > 0.0f) view = glm::normalize(view);
+
+  vector<ChunkJob> jobs;
+  for (auto *chunk : world.grid.cells) {
+    // new chunks, chunks whose job got cancelled, stale chunks and the ones
+    // to mesh again. A mesh is not built again before the last one was
+    // uploaded, which the render thread reads meanwhile.
+    bool needs_gen = chunk->is_being_generated || chunk->is_stale ||
+                     (chunk->is_mesh_stale && !chunk->is_dirty);
+    if (needs_gen && !chunk->is_queued) {
+      chunk->is_queued = true;
+      jobs.push_back(ChunkJob{
+          .chunk = chunk,
+          .x = chunk->x,
+          .y = chunk->y,
+          .priority = chunk_gen_priority(chunk->x, chunk->y, center_x,
+                                         center_y, view),
+      });
     }
   }
+  chunk_pool_submit(pool, std::move(jobs));
+}
+
+void world_queue_side_remeshes(World &world, WorldPos center_pos,
+                               vec3 view_dir) {
+  // the loading pass rebuilds the queue, queue them on the next frame
+  std::unique_lock<std::mutex> load_lock(world.load_mutex, std::try_to_lock);
+  if (!load_lock.owns_lock()) return;
+  auto &pool = world.gen_pool;
+  // started by the first loading pass
+  if (pool.workers.empty()) return;
+  int center_x = center_pos.x;
+  int center_y = center_pos.z;
+  vec2 view{view_dir.x, view_dir.z};
+  if (glm::length(view) > 0.0f) view = glm::normalize(view);
+
+  vector<ChunkJob> jobs;
+  for (auto *chunk : world.grid.cells) {
+    // the side versions were written by the last job of the chunk, which is
+    // done once it is not queued
+    if (!chunk_mesh_patchable(*chunk)) continue;
+    if (chunk_stale_sides(*chunk).none()) continue;
+    chunk->is_queued = true;
+    jobs.push_back(ChunkJob{
+        .chunk = chunk,
+        .x = chunk->x,
+        .y = chunk->y,
+        .priority =
+            chunk_gen_priority(chunk->x, chunk->y, center_x, center_y, view),
+    });
+  }
+  chunk_pool_submit(pool, std::move(jobs));
 }
 
 glm::ivec3 biome_color(BiomeKind bk) {
@@ -1199,10 +2063,8 @@ Color block_kind_color(BlockType bt) {
 }
 
 Block get_top_block_of_column(Chunk &chunk, int x, int y) {
-  auto col = &CHUNK_COL_AT(chunk, x, y);
-  auto topBlockHeight = get_col_height(col);
-  Block topBlock = col[topBlockHeight];
-  return topBlock;
+  return chunk_blocks_get(chunk.blocks, x, y,
+                          chunk_heightmap_top_solid(chunk.heights, x, y));
 }
 
 void foreach_col_in_chunk(Chunk &chunk, std::function<void(int, int)> fun) {
@@ -1213,120 +2075,176 @@ void foreach_col_in_chunk(Chunk &chunk, std::function<void(int, int)> fun) {
   }
 }
 
-constexpr int NM_W = 1024;
-constexpr int NM_H = NM_W;
+// Chunk rows generated at once by the map export. A band is streamed to the
+// PNG writers while the next one is generated, so the memory used is bounded
+// by the width of the map, whatever its length.
+constexpr i32 MAP_BAND_CHUNKS = 4;
+
+enum class MapLayer : u32 {
+  Ortho,
+  Height,
+  Rain,
+  Temperature,
+  Biome,
+};
+constexpr u32 MAP_LAYERS = 5;
+static const char *MAP_LAYER_FILES[MAP_LAYERS] = {
+    "ortho.png", "heightmap.png", "rain_map.png", "temp_map.png",
+    "biome_kind.png",
+};
 
-void world_dump_heights(World &world, const string &out_dir) {
-  fs::create_directory(out_dir);
+// Rows [y, y + rows) of the exported rectangle, row-major like the PNG
+struct MapBand {
+  i32 y = 0;
+  u32 rows = 0;
+  array<vector<Pixel>, MAP_LAYERS> layers;
+};
 
-  auto *ortho_view = new array<array<Pixel, NM_W>, NM_H>();
-  {
-    auto *chunk = new Chunk();
-    fmt::print("Generating complete orthogonal view image\n");
-    // full map ortho view (by chunk)
-    for (i32 x = 0; x < NM_W; x += CHUNK_WIDTH) {
-      for (i32 y = 0; y < NM_H; y += CHUNK_LENGTH) {
-        chunk->x = x;
-        chunk->y = y;
-        gen_chunk(world, *chunk);
-        for (i32 lx = 0; lx < CHUNK_WIDTH; ++lx) {
-          for (i32 ly = 0; ly < CHUNK_LENGTH; ++ly) {
-            auto xx = x + lx;
-            auto yy = y + ly;
-            auto col = &CHUNK_COL_AT(*chunk, lx, ly);
-            uint32_t height = get_col_height(col);
-            Block topBlock = col[height];
-            auto c = block_kind_color(topBlock.type);
-            (*ortho_view)[xx][yy] = c;
-          }
-        }
-      }
+inline Pixel gray_pixel(float v) {
+  auto b = (byte)std::clamp((int)round(v * 255.0f), 0, 255);
+  return rgba_color(b, b, b, byte(255));
+}
+
+// first block of the chunk containing `v`, on an axis of `size` blocks
+inline i32 chunk_floor(i32 v, i32 size) {
+  return v - ((v % size) + size) % size;
+}
+
+// Generates the chunk and fills the pixels of its columns that are in the
+// band. All the layers come from the one climate and height pass of gen_chunk.
+void map_export_chunk(World const &world, WorldRect const &rect,
+                      MapBand &band, Chunk &chunk, ChunkSpill &spill,
+                      array<Pixel, 256> const &block_colors) {
+  // the structures the chunk spills into its neighbours are left out, the
+  // chunks are exported on their own
+  auto &blocks = dense_blocks_scratch();
+  gen_chunk_blocks(world, chunk, blocks, spill);
+  spill.clear();
+  auto &climate = chunk.climate;
+  for (int x = 0; x < CHUNK_WIDTH; ++x) {
+    i32 gx = chunk.x + x;
+    if (gx < rect.x || gx >= rect.x + (i32)rect.width) continue;
+    for (int y = 0; y < CHUNK_LENGTH; ++y) {
+      i32 gy = chunk.y + y;
+      if (gy < band.y || gy >= band.y + (i32)band.rows) continue;
+      size_t i = (size_t)(gy - band.y) * rect.width + (gx - rect.x);
+      auto top = CHUNK_AT(blocks, x, y,
+                          chunk_heightmap_top_solid(chunk.heights, x, y));
+      auto &bn = climate.noise[x][y];
+      auto bc = biome_color(climate.biome[x][y]);
+      auto &layers = band.layers;
+      layers[(u32)MapLayer::Ortho][i] = block_colors[(u8)top.type];
+      layers[(u32)MapLayer::Height][i] =
+          gray_pixel((float)climate.terrain_height[x][y] / CHUNK_HEIGHT);
+      layers[(u32)MapLayer::Rain][i] = gray_pixel(bn.rainfall_noise);
+      layers[(u32)MapLayer::Temperature][i] = gray_pixel(bn.temp_noise);
+      layers[(u32)MapLayer::Biome][i] =
+          rgba_color(byte(bc.r), byte(bc.g), byte(bc.b), byte(255));
     }
   }
+}
 
-  fmt::print("Generating other noise maps...\n");
-  auto *whm = new array<array<Pixel, NM_W>, NM_H>();
-  auto *biome_kind_map = new array<array<Pixel, NM_W>, NM_H>();
-  auto *world_height_map = new array<array<Pixel, NM_W>, NM_H>();
-  auto *temp_map = new array<array<Pixel, NM_W>, NM_H>();
+// Generates the chunks of the band on `nthreads` threads
+void map_export_band(World const &world, WorldRect const &rect, MapBand &band,
+                     u32 nthreads, array<Pixel, 256> const &block_colors) {
+  i32 first_x = chunk_floor(rect.x, CHUNK_WIDTH);
+  i32 first_y = chunk_floor(band.y, CHUNK_LENGTH);
+  i32 cols = (rect.x + (i32)rect.width - first_x + CHUNK_WIDTH - 1) /
+             CHUNK_WIDTH;
+  i32 rows =
+      (band.y + (i32)band.rows - first_y + CHUNK_LENGTH - 1) / CHUNK_LENGTH;
+  std::atomic<i32> next = 0;
+  auto work = [&]() {
+    auto chunk = make_unique<Chunk>();
+    ChunkSpill spill;
+    for (i32 i = next++; i < cols * rows; i = next++) {
+      chunk->x = first_x + (i % cols) * CHUNK_WIDTH;
+      chunk->y = first_y + (i / cols) * CHUNK_LENGTH;
+      map_export_chunk(world, rect, band, *chunk, spill, block_colors);
+    }
+  };
+  vector<std::thread> threads;
+  for (u32 t = 1; t < nthreads; ++t) threads.emplace_back(work);
+  work();
+  for (auto &thread : threads) thread.join();
+}
 
-  for (int x = 0; x < NM_W; ++x) {
-    for (int y = 0; y < NM_H; ++y) {
-      auto temp_noise = temperature_noise_at(world, x, y);
-      auto rainfall_noise = rainfall_noise_at(world, x, y);
+void world_dump_heights(World &world, const string &out_dir, WorldRect rect) {
+  fs::create_directories(out_dir);
+  if (rect.width == 0 || rect.length == 0) {
+    logger::error("The map to export is empty");
+    return;
+  }
 
-      // rainfall noise
-      {
-        int noise_value = round(rainfall_noise * 256);
-        int r = noise_value;
-        int g = noise_value;
-        int b = noise_value;
-        int a = 255;
-        (*whm)[x][y] = rgba_color(byte(r), byte(g), byte(b), byte(a));
-      }
+  array<PngStream, MAP_LAYERS> pngs;
+  bool ok = true;
+  for (u32 l = 0; l < MAP_LAYERS; ++l) {
+    auto path = fmt::format("{}/{}", out_dir, MAP_LAYER_FILES[l]);
+    ok = png_stream_open(pngs[l], path, rect.width, rect.length) && ok;
+  }
+  if (!ok) {
+    for (auto &png : pngs) png_stream_close(png);
+    return;
+  }
 
-      // temperature noise
-      {
-        int noise_value = round(temp_noise * 256);
-        int r = noise_value;
-        int g = noise_value;
-        int b = noise_value;
-        int a = 255;
-        (*temp_map)[x][y] = rgba_color(byte(r), byte(g), byte(b), byte(a));
-      }
+  // looked up once, not per pixel
+  array<Pixel, 256> block_colors;
+  for (u32 i = 0; i < block_colors.size(); ++i) {
+    block_colors[i] = block_kind_color((BlockType)i);
+  }
 
-      auto height_noise = simple_height_noise_at(world, x, y);
-      PointBiomeNoise bn{
-          .height_noise = height_noise,
-          .rainfall_noise = rainfall_noise,
-          .temp_noise = temp_noise,
-      };
-      auto kind = biome_noise_to_kind_at_point(bn);
-      auto &bk = world.biomes_by_kind[kind];
-      auto noise = height_noise_at(world, x, y, bn);
+  u32 nthreads = max(1u, std::thread::hardware_concurrency());
+  fmt::print("Exporting the {}x{} map at {}, {} on {} threads into {}...\n",
+             rect.width, rect.length, rect.x, rect.y, nthreads, out_dir);
 
-      // biome kind
-      {
-        auto bk_color = biome_color(bk.kind);
-        int r = bk_color.r;
-        int g = bk_color.g;
-        int b = bk_color.b;
-        int a = 255;
-        (*biome_kind_map)[x][y] =
-            rgba_color(byte(r), byte(g), byte(b), byte(a));
-      }
+  // one band is generated while the previous one is being written
+  array<MapBand, 2> bands;
+  for (auto &band : bands) {
+    for (auto &layer : band.layers) {
+      layer.resize((size_t)rect.width * MAP_BAND_CHUNKS * CHUNK_LENGTH);
+    }
+  }
+  vector<std::thread> writers;
+  auto join_writers = [&]() {
+    for (auto &writer : writers) writer.join();
+    writers.clear();
+  };
 
-      // heightmap
-      {
-        int noise_value = round(noise * 256);
-        int r = noise_value;
-        int g = noise_value;
-        int b = noise_value;
-        int a = 255;
-        (*world_height_map)[x][y] =
-            rgba_color(byte(r), byte(g), byte(b), byte(a));
-      }
+  i32 end_y = rect.y + (i32)rect.length;
+  u32 band_index = 0;
+  u32 reported = 0;
+  for (i32 y = rect.y; y < end_y; band_index++) {
+    auto &band = bands[band_index % 2];
+    // bands are aligned to the chunks, so no chunk is generated twice
+    i32 band_end =
+        min(chunk_floor(y, CHUNK_LENGTH) + MAP_BAND_CHUNKS * CHUNK_LENGTH,
+            end_y);
+    band.y = y;
+    band.rows = band_end - y;
+    map_export_band(world, rect, band, nthreads, block_colors);
+
+    join_writers();
+    for (u32 l = 0; l < MAP_LAYERS; ++l) {
+      writers.emplace_back([&pngs, &band, l]() {
+        png_stream_write_rows(pngs[l], band.layers[l].data(), band.rows);
+      });
+    }
+    y = band_end;
+
+    u32 percent = (u32)((u64)(y - rect.y) * 100 / rect.length);
+    if (percent >= reported + 10) {
+      reported = percent - percent % 10;
+      fmt::print("{}%\n", reported);
     }
   }
+  join_writers();
 
-  fmt::print("Done with noise.\n");
-  fmt::print("Writing the images into directory at {}...\n", out_dir);
-  stbi_write_png(fmt::format("{}/heightmap.png", out_dir).c_str(), NM_W, NM_H,
-                 4, world_height_map->data(), 0);
-  stbi_write_png(fmt::format("{}/rain_map.png", out_dir).c_str(), NM_W, NM_H, 4,
-                 whm->data(), 0);
-  stbi_write_png(fmt::format("{}/temp_map.png", out_dir).c_str(), NM_W, NM_H, 4,
-                 temp_map->data(), 0);
-  stbi_write_png(fmt::format("{}/biome_kind.png", out_dir).c_str(), NM_W, NM_H,
-                 4, biome_kind_map->data(), 0);
-  stbi_write_png(fmt::format("{}/ortho.png", out_dir).c_str(), NM_W, NM_H, 4,
-                 ortho_view->data(), 0);
+  for (u32 l = 0; l < MAP_LAYERS; ++l) {
+    if (!png_stream_close(pngs[l])) {
+      logger::error(fmt::format("Failed to write {}", MAP_LAYER_FILES[l]));
+    }
+  }
   fmt::print("Done.\n");
-  delete whm;
-  delete biome_kind_map;
-  delete world_height_map;
-  delete temp_map;
-  delete ortho_view;
 }
 
 // Calculate a PNG image representing the orthogonal view of the
@@ -1341,6 +2259,9 @@ Image *calculate_minimap_image(World &world, WorldPos pos, u32 radius) {
   int height = CHUNK_LENGTH * radius;
   auto *image = new Image(width, height);
   for_all_chunks_in_rd(world, [&](Chunk &chunk) {
+    // skip the chunks being generated
+    std::unique_lock<std::mutex> lock(chunk.blocks_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) return;
     int texture_pos_x = chunk.x - first_chunk_x;
     int texture_pos_y = chunk.y - first_chunk_y;
     foreach_col_in_chunk(chunk, [&](int x, int y) -> void {
@@ -1354,6 +2275,7 @@ Image *calculate_minimap_image(World &world, WorldPos pos, u32 radius) {
   return image;
 }
 
+#ifndef HEADLESS
 void calculate_minimap_tex(Texture &texture, World &world, WorldPos pos,
                            u32 radius) {
   auto *img = calculate_minimap_image(world, pos, radius);
@@ -1365,8 +2287,10 @@ void calculate_minimap_tex(Texture &texture, World &world, WorldPos pos,
                GL_UNSIGNED_BYTE, img->data);
   glGenerateMipmap(GL_TEXTURE_2D);
 }
+#endif
 
 void init_world(World &world, Seed seed) {
+  world.seed = seed;
   world.height_noise =
       OpenSimplexNoiseWParam{0.000025f, 32.0f, 2.0f, 0.6f, seed ^ 28394723234234};
   world.rainfall_noise =
@@ -1374,122 +2298,16 @@ void init_world(World &world, Seed seed) {
   world.temperature_noise =
       OpenSimplexNoiseWParam{0.00075f, 1.0f, 2.0f, 0.5f, seed ^ 89213674293468};
 
-  int bseed = seed;
-
-  // Desert
-  world.biomes_by_kind.insert(
-      {BiomeKind::Desert,
-       Biome{
-           .kind = BiomeKind::Desert,
-           .maxHeight = (int)(CHUNK_HEIGHT * 0.55),
-           .noise = OpenSimplexNoiseWParam{0.00002f, 16.0f, 2.0f, 0.5f, bseed},
-           .treeFrequency = 0.0f,
-           .treeGen = build_oak_tree_at,
-           .name = "Desert",
-       }});
-
-  // Forest
-  world.biomes_by_kind.insert(
-      {BiomeKind::Forest,
-       Biome{
-           .kind = BiomeKind::Forest,
-           .maxHeight = (int)(CHUNK_HEIGHT * 0.65),
-           .noise = OpenSimplexNoiseWParam{0.004f, 32.0f, 2.0f, 0.5f, bseed},
-           .treeFrequency = 0.03f,
-           .treeGen = build_oak_tree_at,
-           .name = "Forest",
-       }});
-
-  // Jungle
-  world.biomes_by_kind.insert(
-      {BiomeKind::Jungle,
-       Biome{
-           .kind = BiomeKind::Jungle,
-           .maxHeight = (int)(CHUNK_HEIGHT * 0.66),
-           .noise = OpenSimplexNoiseWParam{0.01f, 32.0f, 2.0f, 0.5f, bseed},
-           .treeFrequency = 0.05f,
-           .treeGen = build_jungle_tree,
-           .name = "Jungle",
-       }});
-
-  // Taiga
-  world.biomes_by_kind.insert(
-      {BiomeKind::Taiga,
-       Biome{
-           .kind = BiomeKind::Taiga,
-           .maxHeight = (int)(CHUNK_HEIGHT * 0.56),
-           .noise = OpenSimplexNoiseWParam{0.004f, 32.0f, 2.0f, 0.5f, bseed},
-           .treeFrequency = 0.02f,
-           .treeGen = build_pine_tree_at,
-           .name = "Taiga",
-       }});
-
-  // Grassland
-  world.biomes_by_kind.insert(
-      {BiomeKind::Grassland,
-       Biome{
-           .kind = BiomeKind::Grassland,
-           .maxHeight = (int)(CHUNK_HEIGHT * 0.55),
-           .noise = OpenSimplexNoiseWParam{0.00001f, 32.0f, 2.0f, 0.5f, bseed},
-           .treeFrequency = 0.0072f,
-           .treeGen = build_oak_tree_at,
-           .name = "Grassland",
-       }});
-
-  // Tundra
-  world.biomes_by_kind.insert(
-      {BiomeKind::Tundra,
-       Biome{
-           .kind = BiomeKind::Tundra,
-           .maxHeight = (int)(CHUNK_HEIGHT * 0.54),
-           .noise = OpenSimplexNoiseWParam{0.002f, 32.0f, 2.0f, 0.5f, bseed},
-           .treeFrequency = 0.005f,
-           .treeGen = build_pine_tree_at,
-           .name = "Tundra",
-       }});
-
-  // Oceans
-  world.biomes_by_kind.insert(
-      {BiomeKind::Ocean,
-       Biome{
-           .kind = BiomeKind::Ocean,
-           .maxHeight = (int)(WATER_LEVEL * 0.8),
-           .noise = OpenSimplexNoiseWParam{0.001f, 1.0f, 2.0f, 0.5f, bseed},
-           .treeFrequency = 0.0f,
-           .treeGen = build_oak_tree_at,
-           .name = "Ocean",
-       }});
-
-  // Coast
-  world.biomes_by_kind.insert(
-      {BiomeKind::Coast,
-       Biome{
-           .kind = BiomeKind::Coast,
-           .maxHeight = WATER_LEVEL + 3,
-           .noise = OpenSimplexNoiseWParam{0.001f, 1.0f, 2.0f, 0.5f, bseed},
-           .treeFrequency = 0.0001f,
-           .treeGen = build_oak_tree_at,
-           .name = "Coast",
-       }});
-
-  // Mountains
-  world.biomes_by_kind.insert(
-      {BiomeKind::Mountains,
-       Biome{
-           .kind = BiomeKind::Mountains,
-           .maxHeight = CHUNK_HEIGHT,
-           .noise = OpenSimplexNoiseWParam{0.001f, 64.0f, 2.0f, 0.5f, bseed},
-           .treeFrequency = 0.004f,
-           .treeGen = build_oak_tree_at,
-           .name = "Mountains",
-       }});
-}
-
-void world_update(World &world, float dt, WorldPos player_pos,
-                  u32 rendering_distance) {
-//  fmt::print("Loading chunks around player at {}\n", player_pos);
+  init_biomes(world.biomes, seed);
+}
+
+// Advances the world time, called every frame
+void world_update(World &world, float dt) {
   // update time
-  int ticks_passed = dt * TICKS_PER_SECOND;
+  // a frame is shorter than a tick at high frame rates, the rest carries over
+  world.pending_ticks += (double)dt * TICKS_PER_SECOND;
+  u32 ticks_passed = (u32)world.pending_ticks;
+  world.pending_ticks -= ticks_passed;
   world.time += ticks_passed;
   if (world.time_of_day >= DAY_DURATION) {
     world.time_of_day = 0;
@@ -1537,7 +2355,22 @@ void world_update(World &world, float dt, WorldPos player_pos,
   } else {
   }
   world.sky_color = mix(colorNight, colorDay, blend_factor);
+}
 
-  load_chunks_around_player(world, player_pos, rendering_distance);
-  unload_distant_chunks(world, player_pos, rendering_distance);
+// Starts the thread that loads the chunks around the player whenever the
+// scheduler is notified of a change
+void world_start_chunk_loading(World &world, WorldPos player_pos,
+                               vec3 view_dir, u32 rendering_distance) {
+  ChunkSchedulerInput input{
+      .player_pos = player_pos,
+      .view_dir = view_dir,
+      .rendering_distance = rendering_distance,
+  };
+  chunk_scheduler_start(
+      world.scheduler, input, [&world](ChunkSchedulerInput const &input) {
+        load_chunks_around_player(world, input.player_pos,
+                                  input.rendering_distance, input.view_dir);
+        unload_distant_chunks(world, input.player_pos,
+                              input.rendering_distance);
+      });
 }
@@ -1,25 +1,40 @@
 #ifndef WORLD_HPP
 #define WORLD_HPP
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bitset>
 #include <glm/glm.hpp>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <random>
 #include <set>
 #include <vector>
 
+#include "biome.hpp"
 #include "block.hpp"
+#include "chunk_map.hpp"
+#include "chunk_pool.hpp"
+#include "chunk_slab.hpp"
+#include "chunk_grid.hpp"
+#include "chunk_heightmap.hpp"
+#include "chunk_storage.hpp"
+#include "chunk_scheduler.hpp"
+#include "edit_journal.hpp"
+#include "edit_log.hpp"
 #include "noise.hpp"
+#include "region_file.hpp"
+#include "structure_store.hpp"
+#include "util.hpp"
+#ifndef HEADLESS
 #include "shaders.hpp"
 #include "texture.hpp"
+#endif
 
 using WorldPos = glm::ivec3;
 
-const int CHUNK_LENGTH = 16;
-const int CHUNK_WIDTH = CHUNK_LENGTH;
-const int CHUNK_HEIGHT = 128;
-const int BLOCKS_OF_AIR_ABOVE = 20;
-
 extern float BLOCK_WIDTH;
 extern float BLOCK_LENGTH;
 extern float BLOCK_HEIGHT;
@@ -52,46 +67,202 @@ constexpr vec3 colorDay =
     vec3(135.0f / 256.0f, 206.0f / 256.0f, 250.0f / 256.0f);
 constexpr vec3 colorNight = vec3(0.0, 0.0, 0.0);
 
+// A vertex of a chunk mesh, packed in 8 bytes and unpacked by basic_vs.glsl,
+// which adds the chunk's origin and looks the normal up from the face
 struct VertexData {
-  glm::vec3 pos;
-  glm::vec3 normal;
-  glm::vec2 uv;
-  float ao;
-  float light;
+  // bits 0-4: x, 5-13: height, 14-18: y, of the block corner from the
+  // chunk's origin; 19-21: face; 22-26 and 27-31: position in the face, in
+  // blocks along the u and v of the texture, which is repeated once per block
+  u32 corner_face_tile;
+  // bits 0-7: atlas tile of the texture, 8-15: ao, 16-23: light
+  u32 texture_shade;
 };
+static_assert(sizeof(VertexData) == 8, "VertexData is uploaded as is");
+static_assert(CHUNK_WIDTH < 32 && CHUNK_LENGTH < 32 && CHUNK_HEIGHT < 512 &&
+                  CHUNK_SECTION_HEIGHT < 32,
+              "VertexData corners and tiles do not fit their bits");
+
+inline VertexData vertex_pack(glm::ivec3 corner, u32 face, u32 tile_u,
+                              u32 tile_v, u32 texture, float ao, float light) {
+  auto shade = [](float value) {
+    return (u32)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+  };
+  return VertexData{
+      .corner_face_tile = (u32)corner.x | (u32)corner.y << 5 |
+                          (u32)corner.z << 14 | face << 19 | tile_u << 22 |
+                          tile_v << 27,
+      .texture_shade = (texture & 0xff) | shade(ao) << 8 | shade(light) << 16,
+  };
+}
+
+inline u32 vertex_tile_u(VertexData v) {
+  return (v.corner_face_tile >> 22) & 0x1f;
+}
+inline u32 vertex_tile_v(VertexData v) { return v.corner_face_tile >> 27; }
 
 using ChunkMesh = std::vector<VertexData>;
 
+// How the faces of the blocks are turned into quads
+enum class ChunkMeshing {
+  // one quad per visible block face
+  Cubes,
+  // coplanar faces of the same block type merged into rectangles
+  Greedy,
+  // the same quads as Cubes, with the faces that show found from a bitmask of
+  // each column
+  Binary,
+};
+// How the quads of a chunk mesh are drawn
+enum class ChunkQuads {
+  // two triangles of 3 vertices each
+  Triangles,
+  // 4 vertices each, drawn with the shared quad index buffer
+  Indexed,
+};
+
+// Corners of a quad, among its 4 vertices, of its two triangles. The index
+// buffer of indexed quads repeats it with the offset of each quad.
+constexpr u32 CHUNK_QUAD_INDICES[6] = {0, 1, 2, 0, 3, 1};
+
+inline u32 chunk_quad_vertices(ChunkQuads quads) {
+  return quads == ChunkQuads::Indexed ? 4 : 6;
+}
+
+// Sides of a chunk, in the order of the faces that look out of them: left,
+// right, front and back
+constexpr u32 CHUNK_SIDES = 4;
+constexpr int CHUNK_SIDE_BLOCKS = std::max(CHUNK_WIDTH, CHUNK_LENGTH);
+
+// A chunk mesh is laid out vertical section by section, then side by side:
+// the faces on the sides of the chunk, which also depend on its neighbours,
+// are kept apart from the sections.
+constexpr u32 CHUNK_MESH_PARTS = CHUNK_SECTIONS + CHUNK_SIDES;
+// Vertex offset of each part of a chunk mesh. The last entry is the vertex
+// count.
+using ChunkMeshSections = std::array<u32, CHUNK_MESH_PARTS + 1>;
+
+// The new vertices of some parts of a chunk mesh, after an edit of a block
+// of the chunk or a change of its neighbours
+struct ChunkMeshPatch {
+  // the parts meshed again
+  std::bitset<CHUNK_MESH_PARTS> parts;
+  // the new vertices of each part in `parts`
+  std::array<ChunkMesh, CHUNK_MESH_PARTS> meshes;
+};
+
+// Offsets of the parts of a mesh laid out as `sections` once the patch is
+// copied into it
+inline ChunkMeshSections chunk_mesh_patched_sections(
+    ChunkMeshSections const& sections, ChunkMeshPatch const& patch) {
+  ChunkMeshSections patched;
+  patched[0] = 0;
+  for (u32 part = 0; part < CHUNK_MESH_PARTS; ++part) {
+    u32 size = patch.parts[part] ? patch.meshes[part].size()
+                                 : sections[part + 1] - sections[part];
+    patched[part + 1] = patched[part] + size;
+  }
+  return patched;
+}
+
+// The blocks of the neighbours next to the sides of a chunk, copied when it
+// is meshed, so the faces on its sides they hide are left out
+struct ChunkHalo {
+  // blocks_version of the neighbour on each side, 0 when it was not there
+  std::array<u32, CHUNK_SIDES> versions{};
+  // the neighbour was there, but another thread held its blocks
+  std::array<bool, CHUNK_SIDES> busy{};
+  // the blocks next to each side that are not air, by position along the
+  // side and height
+  std::bitset<CHUNK_HEIGHT> solid[CHUNK_SIDES][CHUNK_SIDE_BLOCKS];
+};
+
+struct PointBiomeNoise {
+  float height_noise;
+  float rainfall_noise;
+  float temp_noise;
+};
+
+// Climate noise and biome of every column of a chunk. It is computed once per
+// chunk and shared by the terrain fill, the tree pass and biome lookups.
+struct ChunkClimate {
+  PointBiomeNoise noise[CHUNK_WIDTH][CHUNK_LENGTH];
+  BiomeKind biome[CHUNK_WIDTH][CHUNK_LENGTH];
+  // height of the terrain, before the water and the trees
+  u32 terrain_height[CHUNK_WIDTH][CHUNK_LENGTH];
+};
+
 struct Chunk {
-  Block blocks[CHUNK_LENGTH][CHUNK_WIDTH][CHUNK_HEIGHT];
+  ChunkBlocks blocks;
+  ChunkHeightmap heights;
+  ChunkClimate climate;
   uint32_t height = 0;
-  ChunkMesh* mesh;
-
-  bool is_being_generated = true;
+  ChunkMesh* mesh = nullptr;
+  // sections of `mesh`
+  ChunkMeshSections mesh_sections{};
+  // blocks_version of the neighbours the sides of the mesh were meshed
+  // against
+  std::array<u32, CHUNK_SIDES> side_versions{};
+  // parts remeshed by an edit or a side job, waiting to be copied into the
+  // uploaded mesh. Written by the job of the chunk while it is queued, by the
+  // render thread otherwise.
+  unique_ptr<ChunkMeshPatch> mesh_patch;
+  // held while the blocks are generated and meshed, so that an edit does not
+  // write into them meanwhile
+  std::mutex blocks_mutex;
+
+  std::atomic<bool> is_being_generated = true;
+  // changed when the blocks are generated or loaded, or a block on a side is
+  // edited, for the neighbours to mesh their sides again; 0 before
+  std::atomic<u32> blocks_version = 0;
+  // a generation job for the chunk is queued or running
+  std::atomic<bool> is_queued = false;
+  // the last job started when the chunk was unloaded. The jobs up to it may
+  // have found the chunk through a neighbour link or a lookup before then.
+  u64 unloaded_after_job = 0;
+  // when the chunk entered the render radius, until its mesh is first uploaded
+  ChunkClock::time_point entered_radius;
+  bool latency_pending = false;
 
   int x;
   int y;
-  // this flag is set to true if any of the blocks in the chunk has been changed
-  bool is_dirty = false;
+  // set when a worker left a new mesh in `mesh`, cleared by the render thread
+  // once it is uploaded. Block changes are tracked by is_unsaved and
+  // blocks_version.
+  std::atomic<bool> is_dirty = false;
+  // set when the blocks are out of date (an edit, or structure blocks spilled
+  // in by a neighbour) and the chunk has to be generated again
+  std::atomic<bool> is_stale = false;
+  // set when only the mesh is out of date (the meshing settings changed),
+  // the chunk is meshed again from the blocks it has
+  std::atomic<bool> is_mesh_stale = false;
 
   // contains information on the size of the mesh stored in chunk.VAO
   u32 mesh_size = 0;
 
+  // noise samples taken to generate this chunk
+  u64 noise_samples = 0;
+
+  // the structure blocks spilled into the chunk and by it when it was
+  // generated, saved with it
+  IncomingMods spill_in;
+  ChunkSpill spill_out;
+  // the chunk changed since it was last saved
+  std::atomic<bool> is_unsaved = false;
+
+  // the chunks around this one in the render distance grid, by
+  // chunk_neighbour_index; nullptr at the edge of the grid
+  std::array<std::atomic<Chunk*>, 9> neighbours{};
+
+#ifndef HEADLESS
   // GL buffers
   GLuint buffer = 0;
   GLuint vao = 0;
+  // sections of the mesh in `buffer`
+  ChunkMeshSections buffer_sections{};
+#endif
 };
 
-// A hash function used to hash a pair of any kind
 using std::hash;
-struct hash_pair {
-  template <class T1, class T2>
-  size_t operator()(const pair<T1, T2>& p) const {
-    auto hash1 = hash<T1>{}(p.first);
-    auto hash2 = hash<T2>{}(p.second);
-    return hash1 ^ hash2;
-  }
-};
 
 struct hash_tvec3 {
   template <class T>
@@ -99,38 +270,18 @@ struct hash_tvec3 {
     auto hash1 = hash<T>{}(p.x);
     auto hash2 = hash<T>{}(p.y);
     auto hash3 = hash<T>{}(p.z);
-    return hash1 ^ hash2;
+    return mix64(mix64(mix64(hash1) ^ hash2) ^ hash3);
   }
 };
 
-using ChunkId = pair<i32, i32>;
-inline ChunkId chunk_id_from_coords(int x, int y) { return make_pair(x, y); }
-
-enum BiomeKind {
-  Grassland,
-  Mountains,
-  Desert,
-  Ocean,
-  Tundra,
-  Taiga,
-  Forest,
-  Coast,
-  Jungle,
-  Count,
+// How the biome heights are blended into the terrain height
+enum class HeightBlending {
+  // every column blends the height noise of all biomes
+  Exact,
+  // blend on a coarse lattice and interpolate the columns in between
+  Lattice,
 };
 
-struct World;
-
-struct Biome {
-  BiomeKind kind;
-  int maxHeight;
-  OpenSimplexNoiseWParam noise;
-  float treeFrequency;
-  std::function<void(World& world, Chunk& chunk, i32 x, i32 y)> treeGen;
-  const char* name;
-};
-
-const int WATER_LEVEL = (int)(CHUNK_HEIGHT * 0.45);
 const int TICKS_PER_SECOND = 100;
 
 // in ticks (12 minutes)
@@ -142,56 +293,70 @@ const float EVENING = 18.0f * ONE_HOUR;
 const float NIGHT = 22.0f * ONE_HOUR;
 const float ONE_MINUTE = ONE_HOUR / 60.0f;
 
-struct Atom {
-  WorldPos pos;
-  Block block;
-};
-
 using ChunkPos = WorldPos;
 
-struct Mod {
-  ChunkPos pos;
-  BlockType block;
-};
+// Random stream of a chunk. It is seeded from a hash of the world seed and the
+// chunk position only, so a chunk comes out the same whichever thread
+// generates it and in whatever order.
+struct ChunkRng {
+  u64 state;
+
+  ChunkRng(Seed seed, i32 x, i32 y)
+      : state(mix64(mix64((u64)seed) ^ ((u64)(u32)x << 32 | (u32)y))) {}
 
-using ChunkMetaMod = vector<Mod>;
-using MetaMod = unordered_map<ChunkId, ChunkMetaMod, hash_pair>;
+  // splitmix64
+  inline u64 next() {
+    this->state += 0x9e3779b97f4a7c15ULL;
+    return mix64(this->state);
+  }
+
+  // uniform in [0, 1)
+  inline float next_float() { return (float)(this->next() >> 40) * 0x1.0p-24f; }
+};
 
 struct World {
-  int seed = 3849534;
-  std::vector<Chunk*> chunks{};
-  std::unordered_map<ChunkId, Chunk*, hash_pair> loaded_chunks;
+  Seed seed = 3849534;
+  // storage of the chunks, outlives the generation pool
+  ChunkSlabs chunk_slabs;
+  // chunks in the render distance, written by the loading pass with
+  // chunks_mutex held
+  ChunkGrid grid;
+  mutable std::mutex chunks_mutex;
+  // looked up without a lock, the mutex is held to insert, erase or iterate
+  ChunkMap loaded_chunks;
+  mutable std::mutex loaded_chunks_mutex;
+  // held by a chunk loading pass, keeps `chunks` and the loaded chunks from
+  // being reset under it
+  std::mutex load_mutex;
 
   std::vector<pair<ChunkId, Chunk*>> chunks_to_unload;
   std::mutex chunk_unload_mutex;
-
-  std::vector<Atom> changes;
+  // unloaded chunks waiting for their generation job, and the jobs that may
+  // still hold them, to finish; render thread only
+  std::vector<Chunk*> chunks_to_free;
+
+  // blocks placed and broken by the player, in the world named `edits_world`
+  // after its seed and height blending
+  EditJournal edits;
+  string edits_world;
+  // the chunks saved on disk, see world_open_saves
+  RegionStore saves;
+  // the edits as they are made, replayed into `edits` on startup
+  EditLog edit_log;
+
+  // worldgen statistics
+  std::atomic<u64> chunks_generated = 0;
+  // chunks read back from their region file instead
+  std::atomic<u64> chunks_loaded = 0;
+  std::atomic<u64> noise_samples = 0;
 
   // Contains changes made by the worldgen algorithm that need to be applied
   // after chunk generation in order to complete the structure inside of a
   // particular chunk
-  MetaMod meta;
+  StructureStore structures;
 
-  std::random_device rd;
-  std::default_random_engine eng;
-  std::uniform_real_distribution<float> _tree_gen{FLOAT_MIN, FLOAT_MAX};
   OpenSimplexNoiseWParam _tree_noise{1.25f, 1.0f, 2.0f, 0.6f, 1231512};
 
-  inline void tree_gen_seed(i32 x, i32 y) {
-    auto hash1 = hash<i32>{}(x);
-    auto hash2 = hash<i32>{}(y);
-    auto res = hash1 ^ hash2;
-    this->eng.seed(res);
-  }
-
-  inline float tree_structure_noise() {
-    return this->_tree_gen(this->eng);
-  }
-
-  inline float tree_noise(i32 x, i32 y) {
-    return this->_tree_gen(this->eng);
-  }
-
   // SimplexNoise height_noise{0.005f, 1.0f, 2.0f, 0.5f};
   OpenSimplexNoiseWParam height_noise{0.00025f, 64.0f, 2.0f, 0.6f, 345972};
 
@@ -204,6 +369,8 @@ struct World {
   u64 time = 0;
   // time of day [0..DAY_DURATION];
   u32 time_of_day = DAY;
+  // the part of a tick the frames so far have not reached yet
+  double pending_ticks = 0.0;
 
   vec3 origin{0, 0, 0};
 
@@ -220,28 +387,158 @@ struct World {
   optional<WorldPos> target_block_pos;
   optional<Block> target_block;
 
-  std::unordered_map<BiomeKind, Biome> biomes_by_kind;
-  World() { this->eng = std::default_random_engine(this->seed); }
+  BiomeTable biomes;
+  HeightBlending height_blending = HeightBlending::Exact;
+  ChunkMeshing meshing = ChunkMeshing::Greedy;
+  ChunkQuads quads = ChunkQuads::Indexed;
+  // vertices of the chunk meshes built so far, and the block faces they cover
+  std::atomic<u64> meshed_vertices = 0;
+  std::atomic<u64> meshed_faces = 0;
+  // the last Chunk::blocks_version given out
+  std::atomic<u32> last_blocks_version = 0;
+
+  ChunkLatencyStats chunk_latency;
+
+  // last members, so the loading threads are stopped before the rest is
+  // destroyed
+  ChunkGenPool gen_pool;
+  ChunkScheduler scheduler;
 };
 
 void load_chunks_around_player(World& world, WorldPos center_pos,
-                               uint32_t radius);
+                               uint32_t radius, vec3 view_dir);
+// Queues the chunks whose uploaded mesh has sides older than their
+// neighbours on the generation pool, which meshes those sides again into
+// `chunk.mesh_patch`. Called by the render thread on every frame, it only
+// compares block versions; skipped while a loading pass runs.
+void world_queue_side_remeshes(World& world, WorldPos center_pos,
+                               vec3 view_dir);
+void gen_chunk_climate(World const& world, Chunk& chunk);
+void gen_chunk_blocks(World const& world, Chunk& chunk,
+                      DenseChunkBlocks& blocks, ChunkSpill& spill);
+void gen_chunk(World const& world, Chunk& chunk, ChunkSpill& spill);
+// Copies the blocks of the neighbours next to the sides of the chunk. A
+// neighbour that is being generated, or whose blocks are locked, is left out.
+void chunk_halo_copy(Chunk const& chunk, ChunkHalo& halo);
+void gen_chunk_mesh(Chunk& chunk, DenseChunkBlocks const& blocks,
+                    ChunkHalo const& halo, ChunkMeshing meshing,
+                    ChunkQuads quads, ChunkMesh& mesh);
+// Meshes the chunk against the neighbours it has now
+void gen_chunk_mesh(Chunk& chunk, ChunkMeshing meshing, ChunkQuads quads,
+                    ChunkMesh& mesh);
+void gen_chunk_section_mesh(Chunk const& chunk, DenseChunkBlocks const& blocks,
+                            u32 section, ChunkMeshing meshing,
+                            ChunkQuads quads, ChunkMesh& mesh);
+void gen_chunk_side_mesh(Chunk const& chunk, ChunkHalo const& halo, u32 side,
+                         ChunkMeshing meshing, ChunkQuads quads,
+                         ChunkMesh& mesh);
+// Meshes the sides of the chunk whose neighbour arrived, left or changed
+// since they were meshed into `chunk.mesh_patch`, but the ones whose
+// neighbour is busy. The job queued by world_queue_side_remeshes.
+void remesh_chunk_sides_at(World& world, Chunk& chunk);
+// Number of block faces the mesh covers, which is its number of quads when
+// meshed with ChunkMeshing::Cubes
+u64 chunk_mesh_block_faces(ChunkMesh const& mesh, ChunkQuads quads);
+void load_chunk_at(World& world, Chunk& chunk);
+// Builds the mesh of a chunk whose blocks are up to date again
+void remesh_chunk_at(World& world, Chunk& chunk);
+// Marks the loaded chunks to be meshed again with the world's meshing
+// settings, changed by the caller with the loading passes and the workers
+// stopped. Render thread only, a mesh waiting to be uploaded is dropped.
+void world_remesh_chunks(World& world);
+void world_merge_chunk_spill(World& world, Chunk& source, ChunkSpill& spill);
 void place_block_at(World& world, BlockType type, WorldPos pos);
 Block chunk_get_block_at_global(Chunk* chunk, WorldPos pos);
-void world_dump_heights(World& world, const string& out_dir);
+// Columns [x, x + width) x [y, y + length) of the world
+struct WorldRect {
+  i32 x;
+  i32 y;
+  u32 width;
+  u32 length;
+};
+
+// Exports maps of the top blocks, terrain height, rainfall, temperature and
+// biomes of the rectangle as PNG images, one pixel per column
+void world_dump_heights(World& world, const string& out_dir,
+                        WorldRect rect = {0, 0, 1024, 1024});
+// "unknown" while the chunk there is being generated
 const char* get_biome_name_at(World& world, WorldPos pos);
 void foreach_col_in_chunk(Chunk& chunk, std::function<void(int, int)> fun);
+#ifndef HEADLESS
 void calculate_minimap_tex(Texture& texture, World& world, WorldPos pos,
                            u32 radius);
+#endif
+Chunk* find_chunk_with_pos(World& world, WorldPos pos);
 void unload_chunk(Chunk* chunk);
+void free_unloaded_chunks(World& world);
+// Saves the chunks of the world's seed and terrain settings in a directory of
+// `dir`, and loads them from there, and replays the edits logged there into
+// the journal. An empty `dir` saves nothing.
+void world_open_saves(World& world, const string& dir);
+// Queues the chunk to be written to its region file when it changed since it
+// was last saved. No job may be running for it.
+void world_save_chunk(World& world, Chunk& chunk);
+// Saves the loaded chunks and the ones waiting to be freed, with the
+// generation pool stopped or drained. Render thread only.
+void world_save_chunks(World& world);
 void unload_distant_chunks(World& world, WorldPos pos, u32 rendering_distance);
 void init_world(World& world);
+// Nothing when the chunk is not loaded, or its blocks are being generated
 optional<Block> get_block_at_global_pos(World& world, WorldPos pos);
 void init_world(World& world, Seed seed);
-void world_update(World& world, float dt, WorldPos player_pos,
-                  u32 rendering_distance);
+void world_update(World& world, float dt);
+void world_start_chunk_loading(World& world, WorldPos player_pos,
+                               vec3 view_dir, u32 rendering_distance);
+inline Chunk* is_chunk_loaded(World& world, int x, int y) {
+  return chunk_map_find(world.loaded_chunks, chunk_id_from_coords(x, y));
+}
+
+// The chunk at the block position `x`, `y` in the grid, or nullptr
+inline Chunk* chunk_grid_find(ChunkGrid const& grid, i32 x, i32 y) {
+  if (!chunk_grid_contains(grid, x, y)) return nullptr;
+  auto* chunk = grid.cells[chunk_grid_cell(grid, x, y)];
+  if (chunk == nullptr || chunk->x != x || chunk->y != y) return nullptr;
+  return chunk;
+}
+
+// The chunk `dx`, `dy` chunks away from this one (-1 to 1), without a lookup.
+// The position is checked: an unloaded chunk is recycled, a pointer to it may
+// be seen for a moment before it is unlinked.
+inline Chunk* chunk_neighbour(Chunk const& chunk, int dx, int dy) {
+  auto* neighbour = chunk.neighbours[chunk_neighbour_index(dx, dy)].load();
+  if (neighbour == nullptr || neighbour->x != chunk.x + dx * CHUNK_WIDTH ||
+      neighbour->y != chunk.y + dy * CHUNK_LENGTH) {
+    return nullptr;
+  }
+  return neighbour;
+}
+
+// The block at a position local to the chunk, up to one chunk outside of it,
+// read from the neighbour it falls in. The caller holds the blocks of
+// `chunk`. Nothing when that neighbour is not in the grid, is being generated
+// or its blocks are busy, as a thread never waits for a second chunk.
+inline optional<Block> chunk_get_block_near(Chunk const& chunk, int x, int y,
+                                            int z) {
+  if (z < 0 || z >= CHUNK_HEIGHT) return {};
+  int dx = x < 0 ? -1 : x >= CHUNK_WIDTH ? 1 : 0;
+  int dy = y < 0 ? -1 : y >= CHUNK_LENGTH ? 1 : 0;
+  if (dx == 0 && dy == 0) return chunk_blocks_get(chunk.blocks, x, y, z);
+  auto* neighbour = chunk_neighbour(chunk, dx, dy);
+  if (neighbour == nullptr) return {};
+  std::unique_lock<std::mutex> lock(neighbour->blocks_mutex,
+                                    std::try_to_lock);
+  if (!lock.owns_lock() || neighbour->is_being_generated) return {};
+  return chunk_blocks_get(neighbour->blocks, x - dx * CHUNK_WIDTH,
+                          y - dy * CHUNK_LENGTH, z);
+}
+
 inline void for_all_chunks_in_rd(World& world, function<void(Chunk&)> fun) {
-  for (auto& chunk : world.chunks) {
+  vector<Chunk*> chunks;
+  {
+    std::lock_guard<std::mutex> guard(world.chunks_mutex);
+    chunks = world.grid.cells;
+  }
+  for (auto& chunk : chunks) {
     if (chunk == nullptr) continue;
     if (chunk->is_being_generated) continue;
     fun(*chunk);